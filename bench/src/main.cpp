@@ -0,0 +1,128 @@
+
+#include <ns/loader.h>
+#include <ns/isolated.h>
+
+#include <stdio.h>
+#include <chrono>
+
+static constexpr int INSTANCE_COUNT = 1000;
+static constexpr int FRAME_COUNT = 1000;
+
+using Clock = std::chrono::steady_clock;
+
+static double nanosecondsPerCall(Clock::time_point start) {
+	double total = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+	return total / ((double)INSTANCE_COUNT * FRAME_COUNT);
+}
+
+int main(int argc, char** argv) {
+	using namespace ns;
+
+	if (argc < 2 || argc > 3) {
+		printf("Invalid number of arguments. Benchmark require a library path and optionally the ns-host path.\n");
+		return 1;
+	}
+	const char* hostPath = argc == 3 ? argv[2] : "ns-host";
+
+	// Pick the first script exposing an int property
+	auto collection = ScriptCollection::create(argv[1]);
+	if (!collection) {
+		printf("Failed to load library: %s\n", argv[1]);
+		return 1;
+	}
+
+	const ScriptInterface* script = nullptr;
+	int parameter = -1;
+	for (const auto& [name, candidate] : collection->getScripts()) {
+		for (size_t i = 0; i < candidate.parameters.size() && !script; ++i) {
+			if (candidate.parameters[i].type == ParameterType::INT) {
+				script = &candidate;
+				parameter = (int)i;
+			}
+		}
+	}
+	if (!script) {
+		printf("Library has no script with an int property\n");
+		return 1;
+	}
+	printf("Script: %s, property: %s, %d instances, %d frames\n", script->name.c_str(), script->parameters[parameter].name.c_str(), INSTANCE_COUNT, FRAME_COUNT);
+
+	// In process
+	{
+		const Parameter& property = script->parameters[parameter];
+
+		std::vector<Script*> instances;
+		for (int i = 0; i < INSTANCE_COUNT; ++i) {
+			instances.push_back(script->createScriptFunc());
+			instances.back()->start();
+		}
+
+		long long checksum = 0;
+		auto start = Clock::now();
+		for (int frame = 0; frame < FRAME_COUNT; ++frame) {
+			for (Script* instance : instances) {
+				property.set(instance, frame);
+				instance->update();
+			}
+			for (Script* instance : instances) {
+				checksum += property.getAsInt(instance);
+			}
+		}
+		printf("In process: %.1f ns per set/update/get (checksum %lld)\n", nanosecondsPerCall(start), checksum);
+
+		for (Script* instance : instances) {
+			script->destroyScriptFunc(instance);
+		}
+	}
+
+	// Isolated
+	{
+		auto isolated = IsolatedScriptCollection::create(argv[1], hostPath);
+		if (!isolated) {
+			printf("Failed to start script host: %s\n", hostPath);
+			return 1;
+		}
+
+		int scriptIndex = isolated->getScriptIndex(script->name);
+		if (scriptIndex < 0) {
+			printf("Script host does not know script: %s\n", script->name.c_str());
+			return 1;
+		}
+
+		std::vector<int> instances;
+		for (int i = 0; i < INSTANCE_COUNT; ++i) {
+			int instance = isolated->createScript(scriptIndex);
+			if (instance < 0 || !isolated->getValue(instance, parameter)) {
+				printf("Failed to create isolated instance of %s\n", script->name.c_str());
+				return 1;
+			}
+			instances.push_back(instance);
+			isolated->startScript(instance);
+		}
+		if (!isolated->flush()) {
+			return 1;
+		}
+
+		long long checksum = 0;
+		auto start = Clock::now();
+		for (int frame = 0; frame < FRAME_COUNT; ++frame) {
+			for (int instance : instances) {
+				isolated->getValue(instance, parameter)->asInt = frame;
+				isolated->updateScript(instance);
+			}
+			if (!isolated->flush()) {
+				return 1;
+			}
+			for (int instance : instances) {
+				checksum += isolated->getValue(instance, parameter)->asInt;
+			}
+		}
+		printf("Isolated:   %.1f ns per set/update/get (checksum %lld)\n", nanosecondsPerCall(start), checksum);
+
+		for (int instance : instances) {
+			isolated->destroyScript(instance);
+		}
+	}
+
+	return 0;
+}
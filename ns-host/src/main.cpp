@@ -0,0 +1,13 @@
+
+#include <ns/isolated.h>
+
+#include <stdio.h>
+#include <filesystem>
+
+int main(int argc, char** argv) {
+	if (argc != 3) {
+		printf("Invalid number of arguments. Tool require a library path and shared memory name.\n");
+		return 1;
+	}
+	return ns::runIsolatedHost(std::filesystem::absolute(argv[1]).generic_string(), argv[2]);
+}
@@ -1,10 +1,48 @@
 
 #include <ns/generator.h>
+#include <ns/watcher.h>
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include <filesystem>
 
 int main(int argc, char** argv) {
+	if (argc > 1 && strcmp(argv[1], "--watch") == 0) {
+		ns::WatchOptions options;
+		const char* paths[2] = {};
+		int pathCount = 0;
+
+		for (int i = 2; i < argc; ++i) {
+			if (strcmp(argv[i], "--debounce") == 0 && i + 1 < argc) {
+				const char* value = argv[++i];
+				char* end;
+				long debounceMs = strtol(value, &end, 10);
+				if (end == value || *end != '\0' || debounceMs < 0 || debounceMs > INT_MAX) {
+					printf("Invalid debounce: %s. Expected a non-negative number of milliseconds.\n", value);
+					return 1;
+				}
+				options.debounceMs = (int)debounceMs;
+			}
+			else if (strcmp(argv[i], "--build") == 0 && i + 1 < argc) {
+				options.buildCommand = argv[++i];
+			}
+			else if (pathCount < 2) {
+				paths[pathCount++] = argv[i];
+			}
+			else {
+				pathCount = 3;
+			}
+		}
+
+		if (pathCount != 2) {
+			printf("Invalid arguments. Usage: nsg --watch <project path> <output folder> [--debounce ms] [--build command]\n");
+			return 1;
+		}
+		return ns::watchProject(std::filesystem::absolute(paths[0]).generic_string().c_str(), std::filesystem::absolute(paths[1]).generic_string().c_str(), options);
+	}
+
 	if (argc != 3) {
 		printf("Invalid number of arguments. Tool require a project path and output folder.\n");
 		return 1;
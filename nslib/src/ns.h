@@ -2,6 +2,11 @@
 
 #include <string>
 #include <vector>
+#include <new>
+
+#ifdef NS_COROUTINES
+	#include "ns/task.h"
+#endif
 
 #ifdef _WIN32
 	#define NS_EXPORT __declspec(dllexport)
@@ -19,6 +24,11 @@ class Script {
 public:
 	virtual void start() {};
 	virtual void update() {};
+
+#ifdef NS_COROUTINES
+	// Coroutine entry point, driven by ns::Scheduler. Scripts without one return an empty task.
+	virtual ns::Task run() { return {}; };
+#endif
 };
 
 namespace ns {
@@ -53,6 +63,26 @@ namespace ns {
 		std::vector<FunctionInfo> functions;
 		std::string nameCreateFn;
 		std::string nameDestroyFn;
+		std::string nameSizeFn;
+		std::string nameSetAllocatorFn;
+	};
+
+	typedef void* (*AllocateScriptFn)(void* userData, size_t size);
+	typedef void (*FreeScriptFn)(void* userData, void* memory);
+	typedef void (*CountScriptFn)(int type);
+
+	// Used by the generated create and destroy functions when set, scripts use new and delete otherwise.
+	// allocate may return nullptr, creating the script fails in that case.
+	struct ScriptAllocator {
+		AllocateScriptFn allocate = nullptr;
+		FreeScriptFn free = nullptr;
+		void* userData = nullptr;
+		size_t maxSize = 0; // Largest allocation the allocator can serve, 0 if unbounded
+
+		// Installed by ScriptCollection so every instance is counted, however it was created
+		CountScriptFn onCreated = nullptr;
+		CountScriptFn onDestroyed = nullptr;
+		int countType = -1;
 	};
 
 }
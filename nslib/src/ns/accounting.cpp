@@ -0,0 +1,339 @@
+#include "accounting.h"
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <stdio.h>
+
+namespace ns {
+
+	static constexpr int MAX_SCRIPT_TYPES = 1024;
+	static constexpr long long PEAK_BATCH = 32;
+
+	// Written only by the owning thread, read by snapshots
+	struct TypeCounter {
+		std::atomic<long long> created = 0;
+		std::atomic<long long> destroyed = 0;
+
+		// Owner thread only, creations not yet added to the published count
+		long long pending = 0;
+		long long localBase = 0;
+		long long localPeak = 0;
+		unsigned int generation = 0;
+	};
+
+	struct ThreadCounters {
+		TypeCounter types[MAX_SCRIPT_TYPES];
+	};
+
+	struct TypeRecord {
+		bool used = false;
+		int library = -1;
+		std::string name;
+		size_t instanceSize = 0;
+
+		long long baseCreated = 0;
+		long long baseDestroyed = 0;
+
+		std::atomic<unsigned int> generation = 0;
+		// Flushed creations minus all destructions, never above the real live count
+		std::atomic<long long> published = 0;
+		std::atomic<long long> peak = 0;
+	};
+
+	struct LibraryRecord {
+		bool used = false;
+		std::string path;
+		size_t metadataBytes = 0;
+		std::vector<int> types;
+	};
+
+	struct Registry {
+		std::mutex mutex;
+
+		std::vector<std::unique_ptr<ThreadCounters>> threads;
+		std::vector<ThreadCounters*> freeThreads;
+
+		TypeRecord types[MAX_SCRIPT_TYPES];
+		std::vector<int> freeTypes;
+		int nextType = 0;
+
+		std::vector<LibraryRecord> libraries;
+	};
+
+	static Registry& getRegistry() {
+		static Registry s_registry;
+		return s_registry;
+	}
+
+	static void atomicMax(std::atomic<long long>& target, long long value) {
+		long long current = target.load(std::memory_order_relaxed);
+		while (current < value && !target.compare_exchange_weak(current, value, std::memory_order_relaxed));
+	}
+
+	static void flushCounter(int type, TypeCounter& counter) {
+		long long live = getRegistry().types[type].published.fetch_add(counter.pending, std::memory_order_relaxed) + counter.pending;
+		counter.pending = 0;
+		atomicMax(getRegistry().types[type].peak, live);
+	}
+
+	// Hands out a counter block per thread, blocks of finished threads keep their counts and are reused
+	struct ThreadHandle {
+		ThreadCounters* counters = nullptr;
+
+		~ThreadHandle() {
+			if (!counters) {
+				return;
+			}
+
+			Registry& registry = getRegistry();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			for (int i = 0; i < MAX_SCRIPT_TYPES; ++i) {
+				TypeCounter& counter = counters->types[i];
+				if (counter.pending != 0 && counter.generation == registry.types[i].generation.load(std::memory_order_relaxed)) {
+					flushCounter(i, counter);
+				}
+				counter.pending = 0;
+			}
+			registry.freeThreads.push_back(counters);
+		}
+	};
+
+	static TypeCounter& getCounter(int type) {
+		thread_local ThreadHandle t_handle;
+		if (!t_handle.counters) {
+			Registry& registry = getRegistry();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			if (!registry.freeThreads.empty()) {
+				t_handle.counters = registry.freeThreads.back();
+				registry.freeThreads.pop_back();
+			}
+			else {
+				registry.threads.push_back(std::make_unique<ThreadCounters>());
+				t_handle.counters = registry.threads.back().get();
+			}
+		}
+
+		TypeCounter& counter = t_handle.counters->types[type];
+
+		// The type id was reused by another script since this thread last saw it
+		unsigned int generation = getRegistry().types[type].generation.load(std::memory_order_relaxed);
+		if (counter.generation != generation) {
+			counter.generation = generation;
+			counter.pending = 0;
+			counter.localBase = counter.created.load(std::memory_order_relaxed) - counter.destroyed.load(std::memory_order_relaxed);
+			counter.localPeak = 0;
+		}
+		return counter;
+	}
+
+	void recordScriptCreated(int type) {
+		if (type < 0) {
+			return;
+		}
+
+		TypeCounter& counter = getCounter(type);
+		long long created = counter.created.load(std::memory_order_relaxed) + 1;
+		counter.created.store(created, std::memory_order_relaxed);
+		++counter.pending;
+
+		// Publish in batches, or right away when this thread reaches a new high so single threaded peaks are exact
+		long long localLive = created - counter.destroyed.load(std::memory_order_relaxed) - counter.localBase;
+		if (counter.pending >= PEAK_BATCH || localLive > counter.localPeak) {
+			counter.localPeak = localLive > counter.localPeak ? localLive : counter.localPeak;
+			flushCounter(type, counter);
+		}
+	}
+
+	void recordScriptDestroyed(int type) {
+		if (type < 0) {
+			return;
+		}
+
+		TypeCounter& counter = getCounter(type);
+		counter.destroyed.store(counter.destroyed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+		// Published right away, a destruction held back on one thread while another publishes
+		// its creations would make the shared count exceed the real one and overstate the peak
+		getRegistry().types[type].published.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	// Caller holds the registry mutex
+	static void sumCounters(const Registry& registry, int type, long long& created, long long& destroyed) {
+		created = 0;
+		destroyed = 0;
+		for (const auto& thread : registry.threads) {
+			created += thread->types[type].created.load(std::memory_order_relaxed);
+			destroyed += thread->types[type].destroyed.load(std::memory_order_relaxed);
+		}
+	}
+
+	long long getLiveInstances(int type) {
+		if (type < 0) {
+			return 0;
+		}
+
+		Registry& registry = getRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+
+		long long created, destroyed;
+		sumCounters(registry, type, created, destroyed);
+		const TypeRecord& record = registry.types[type];
+		return (created - record.baseCreated) - (destroyed - record.baseDestroyed);
+	}
+
+	int registerLibrary(const std::string& path, size_t metadataBytes) {
+		Registry& registry = getRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+
+		for (size_t i = 0; i < registry.libraries.size(); ++i) {
+			if (!registry.libraries[i].used) {
+				registry.libraries[i] = LibraryRecord{ true, path, metadataBytes, {} };
+				return (int)i;
+			}
+		}
+		registry.libraries.push_back(LibraryRecord{ true, path, metadataBytes, {} });
+		return (int)registry.libraries.size() - 1;
+	}
+
+	int registerScriptType(int library, const std::string& name, size_t instanceSize) {
+		Registry& registry = getRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+
+		int type;
+		if (!registry.freeTypes.empty()) {
+			type = registry.freeTypes.back();
+			registry.freeTypes.pop_back();
+		}
+		else if (registry.nextType < MAX_SCRIPT_TYPES) {
+			type = registry.nextType++;
+		}
+		else {
+			printf("Too many script types, %s will not be accounted for\n", name.c_str());
+			return -1;
+		}
+
+		TypeRecord& record = registry.types[type];
+		record.used = true;
+		record.library = library;
+		record.name = name;
+		record.instanceSize = instanceSize;
+		sumCounters(registry, type, record.baseCreated, record.baseDestroyed);
+		record.generation.fetch_add(1, std::memory_order_relaxed);
+		record.published.store(0, std::memory_order_relaxed);
+		record.peak.store(0, std::memory_order_relaxed);
+
+		registry.libraries[library].types.push_back(type);
+		return type;
+	}
+
+	void unregisterLibrary(int library) {
+		if (library < 0) {
+			return;
+		}
+
+		Registry& registry = getRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+
+		LibraryRecord& record = registry.libraries[library];
+		for (int type : record.types) {
+			registry.types[type].used = false;
+			registry.freeTypes.push_back(type);
+		}
+		record = LibraryRecord{};
+	}
+
+	MemorySnapshot takeMemorySnapshot() {
+		Registry& registry = getRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+
+		MemorySnapshot snapshot;
+		for (const LibraryRecord& library : registry.libraries) {
+			if (!library.used) {
+				continue;
+			}
+
+			LibraryMemoryStats libraryStats;
+			libraryStats.path = library.path;
+			libraryStats.metadataBytes = library.metadataBytes;
+
+			for (int type : library.types) {
+				TypeRecord& record = registry.types[type];
+
+				long long created, destroyed;
+				sumCounters(registry, type, created, destroyed);
+
+				ScriptMemoryStats stats;
+				stats.name = record.name;
+				stats.instanceSize = record.instanceSize;
+				stats.totalCreated = created - record.baseCreated;
+				stats.liveInstances = stats.totalCreated - (destroyed - record.baseDestroyed);
+
+				atomicMax(record.peak, stats.liveInstances);
+				stats.peakInstances = record.peak.load(std::memory_order_relaxed);
+				stats.liveBytes = (size_t)stats.liveInstances * stats.instanceSize;
+				stats.peakBytes = (size_t)stats.peakInstances * stats.instanceSize;
+
+				libraryStats.liveBytes += stats.liveBytes;
+				libraryStats.scripts.push_back(stats);
+			}
+
+			snapshot.liveBytes += libraryStats.liveBytes;
+			snapshot.metadataBytes += libraryStats.metadataBytes;
+			snapshot.libraries.push_back(libraryStats);
+		}
+		return snapshot;
+	}
+
+
+	ScriptPool::ScriptPool(size_t blockSize, size_t blocksPerChunk)
+		: m_blocksPerChunk(blocksPerChunk) {
+		size_t alignment = alignof(std::max_align_t);
+		size_t size = blockSize < sizeof(FreeBlock) ? sizeof(FreeBlock) : blockSize;
+		m_blockSize = (size + alignment - 1) / alignment * alignment;
+	}
+
+	ScriptPool::~ScriptPool() {
+		for (void* chunk : m_chunks) {
+			::operator delete(chunk);
+		}
+	}
+
+	size_t ScriptPool::getReservedBytes() const {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_chunks.size() * m_blocksPerChunk * m_blockSize;
+	}
+
+	void* ScriptPool::allocate(void* userData, size_t size) {
+		ScriptPool* pool = (ScriptPool*)userData;
+		if (size > pool->m_blockSize) {
+			return nullptr;
+		}
+
+		std::lock_guard<std::mutex> lock(pool->m_mutex);
+		if (!pool->m_free) {
+			char* chunk = (char*)::operator new(pool->m_blockSize * pool->m_blocksPerChunk);
+			pool->m_chunks.push_back(chunk);
+
+			for (size_t i = 0; i < pool->m_blocksPerChunk; ++i) {
+				FreeBlock* block = (FreeBlock*)(chunk + i * pool->m_blockSize);
+				block->next = pool->m_free;
+				pool->m_free = block;
+			}
+		}
+
+		FreeBlock* block = pool->m_free;
+		pool->m_free = block->next;
+		return block;
+	}
+
+	void ScriptPool::free(void* userData, void* memory) {
+		ScriptPool* pool = (ScriptPool*)userData;
+
+		std::lock_guard<std::mutex> lock(pool->m_mutex);
+		FreeBlock* block = (FreeBlock*)memory;
+		block->next = pool->m_free;
+		pool->m_free = block;
+	}
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "ns.h"
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <stddef.h>
+
+namespace ns {
+
+	struct ScriptMemoryStats {
+		std::string name;
+		size_t instanceSize = 0;
+		long long liveInstances = 0;
+		long long peakInstances = 0;
+		long long totalCreated = 0;
+		size_t liveBytes = 0;
+		size_t peakBytes = 0;
+	};
+
+	struct LibraryMemoryStats {
+		std::string path;
+		size_t metadataBytes = 0;
+		size_t liveBytes = 0;
+		std::vector<ScriptMemoryStats> scripts;
+	};
+
+	struct MemorySnapshot {
+		size_t liveBytes = 0;
+		size_t metadataBytes = 0;
+		std::vector<LibraryMemoryStats> libraries;
+	};
+
+	// Counts are kept per thread and merged when a snapshot is taken, so creating scripts
+	// never contends on shared memory. Live values are exact. Creations are published in
+	// batches and destructions right away, so peaks are never overstated but can lag
+	// behind by a few instances per thread.
+	MemorySnapshot takeMemorySnapshot();
+
+	// Called by ScriptCollection, ids are reused once a library is unregistered
+	int registerLibrary(const std::string& path, size_t metadataBytes);
+	int registerScriptType(int library, const std::string& name, size_t instanceSize);
+	void unregisterLibrary(int library);
+
+	// Called by the generated create and destroy functions through ScriptAllocator
+	void recordScriptCreated(int type);
+	void recordScriptDestroyed(int type);
+
+	// Exact number of live instances of a type, summed over all threads
+	long long getLiveInstances(int type);
+
+
+	// Fixed size free list for the instances of one script type, hand getAllocator() to
+	// ScriptCollection::setAllocator before creating instances. Must outlive the instances.
+	class ScriptPool {
+	public:
+		explicit ScriptPool(size_t blockSize, size_t blocksPerChunk = 64);
+		~ScriptPool();
+
+		ScriptPool(const ScriptPool&) = delete;
+		ScriptPool& operator=(const ScriptPool&) = delete;
+
+		ScriptAllocator getAllocator() {
+			ScriptAllocator allocator;
+			allocator.allocate = &allocate;
+			allocator.free = &free;
+			allocator.userData = this;
+			allocator.maxSize = m_blockSize;
+			return allocator;
+		}
+		size_t getReservedBytes() const;
+
+	private:
+		struct FreeBlock {
+			FreeBlock* next;
+		};
+
+		// Returns nullptr for requests larger than a block
+		static void* allocate(void* userData, size_t size);
+		static void free(void* userData, void* memory);
+
+		size_t m_blockSize;
+		size_t m_blocksPerChunk;
+
+		mutable std::mutex m_mutex;
+		std::vector<void*> m_chunks;
+		FreeBlock* m_free = nullptr;
+	};
+
+}
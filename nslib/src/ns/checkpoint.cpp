@@ -0,0 +1,398 @@
+#include "checkpoint.h"
+
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <unordered_set>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+namespace ns {
+
+	namespace fs = std::filesystem;
+
+	static uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+		// FNV-1a
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; ++i) {
+			hash ^= bytes[i];
+			hash *= 0x100000001B3ull;
+		}
+		return hash;
+	}
+
+	uint64_t computeSchemaHash(const ScriptInterface& script) {
+		uint64_t hash = 0xCBF29CE484222325ull;
+		hash = hashBytes(hash, script.name.c_str(), script.name.size() + 1);
+		for (const Parameter& parameter : script.parameters) {
+			int type = (int)parameter.type;
+			hash = hashBytes(hash, &type, sizeof(type));
+			hash = hashBytes(hash, parameter.name.c_str(), parameter.name.size() + 1);
+		}
+		return hash;
+	}
+
+	// Names are compared in full on restore, longer names are rejected instead of truncated
+	static bool copyName(char* destination, const std::string& source) {
+		if (source.size() >= CHECKPOINT_MAX_NAME) {
+			printf("Name too long for a checkpoint: %s\n", source.c_str());
+			return false;
+		}
+		memcpy(destination, source.c_str(), source.size() + 1);
+		return true;
+	}
+
+	static double toDouble(const Value& value, ParameterType type) {
+		switch (type) {
+		case ParameterType::INT: return value.asInt;
+		case ParameterType::CHAR: return value.asChar;
+		case ParameterType::BOOL: return value.asBool;
+		case ParameterType::FLOAT: return value.asFloat;
+		case ParameterType::DOUBLE: return value.asDouble;
+		case ParameterType::WCHAR_T: return value.asWChar;
+		default: return 0.0;
+		}
+	}
+
+	static Value convertValue(const Value& value, ParameterType from, ParameterType to) {
+		if (from == to) {
+			return value;
+		}
+
+		double x = toDouble(value, from);
+		Value result{};
+		switch (to) {
+		case ParameterType::INT: result.asInt = (int)x; break;
+		case ParameterType::CHAR: result.asChar = (char)x; break;
+		case ParameterType::BOOL: result.asBool = x != 0.0; break;
+		case ParameterType::FLOAT: result.asFloat = (float)x; break;
+		case ParameterType::DOUBLE: result.asDouble = x; break;
+		case ParameterType::WCHAR_T: result.asWChar = (wchar_t)x; break;
+		default: break;
+		}
+		return result;
+	}
+
+
+	bool ScriptCollection::checkpoint(const std::string& path) const {
+		// Group instances by script, types are sorted by name and instances by key so the file is stable
+		std::vector<const ScriptInterface*> types;
+		std::unordered_map<const ScriptInterface*, std::vector<std::pair<uint64_t, Script*>>> instances;
+		for (const auto& [script, scriptInterface] : m_instances) {
+			auto& list = instances[scriptInterface];
+			if (list.empty()) {
+				types.push_back(scriptInterface);
+			}
+			list.emplace_back(m_instanceKeys.at(script), script);
+		}
+		std::sort(types.begin(), types.end(), [](const ScriptInterface* a, const ScriptInterface* b) { return a->name < b->name; });
+		for (auto& [scriptInterface, list] : instances) {
+			std::sort(list.begin(), list.end());
+		}
+
+		std::vector<CheckpointType> entries(types.size());
+		uint64_t offset = sizeof(CheckpointHeader) + sizeof(CheckpointType) * types.size();
+		for (size_t i = 0; i < types.size(); ++i) {
+			CheckpointType& entry = entries[i];
+			memset(&entry, 0, sizeof(entry));
+			if (!copyName(entry.name, types[i]->name)) {
+				return false;
+			}
+			entry.schemaHash = computeSchemaHash(*types[i]);
+			entry.fieldCount = (uint32_t)types[i]->parameters.size();
+			entry.instanceCount = (uint32_t)instances[types[i]].size();
+			entry.fieldOffset = offset;
+			entry.keyOffset = entry.fieldOffset + sizeof(CheckpointField) * entry.fieldCount;
+			entry.valueOffset = entry.keyOffset + sizeof(uint64_t) * entry.instanceCount;
+			offset = entry.valueOffset + sizeof(Value) * entry.fieldCount * entry.instanceCount;
+		}
+
+		std::vector<CheckpointField> fields;
+		for (const ScriptInterface* scriptInterface : types) {
+			for (const Parameter& parameter : scriptInterface->parameters) {
+				CheckpointField field;
+				memset(&field, 0, sizeof(field));
+				if (!copyName(field.name, parameter.name)) {
+					return false;
+				}
+				field.type = parameter.type;
+				fields.push_back(field);
+			}
+		}
+
+		CheckpointHeader header = { CHECKPOINT_MAGIC, CHECKPOINT_VERSION, (uint32_t)types.size(), 0, offset };
+
+		// Write next to the target and swap it in, a crash mid write keeps the previous checkpoint
+		fs::path temporaryPath = path + ".tmp";
+		std::error_code error;
+		{
+			std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+			if (!out) {
+				printf("Failed to open checkpoint for writing: %s\n", temporaryPath.generic_string().c_str());
+				return false;
+			}
+
+			out.write((const char*)&header, sizeof(header));
+			out.write((const char*)entries.data(), sizeof(CheckpointType) * entries.size());
+
+			const CheckpointField* typeFields = fields.data();
+			std::vector<uint64_t> keys;
+			std::vector<Value> values;
+			for (size_t i = 0; i < types.size(); ++i) {
+				out.write((const char*)typeFields, sizeof(CheckpointField) * entries[i].fieldCount);
+				typeFields += entries[i].fieldCount;
+
+				keys.clear();
+				values.clear();
+				for (const auto& [key, script] : instances[types[i]]) {
+					keys.push_back(key);
+					for (const Parameter& parameter : types[i]->parameters) {
+						values.push_back(parameter.getValue(script));
+					}
+				}
+				out.write((const char*)keys.data(), sizeof(uint64_t) * keys.size());
+				out.write((const char*)values.data(), sizeof(Value) * values.size());
+			}
+
+			out.close();
+			if (!out) {
+				printf("Failed to write checkpoint: %s\n", temporaryPath.generic_string().c_str());
+				fs::remove(temporaryPath, error);
+				return false;
+			}
+		}
+
+		fs::rename(temporaryPath, path, error);
+		if (error) {
+			printf("Failed to replace checkpoint: %s\n", error.message().c_str());
+			fs::remove(temporaryPath, error);
+			return false;
+		}
+		return true;
+	}
+
+	std::vector<RestoredScript> ScriptCollection::restore(const Checkpoint& checkpoint) {
+		std::vector<RestoredScript> scripts;
+		for (uint32_t i = 0; i < checkpoint.getTypeCount(); ++i) {
+			std::vector<RestoredScript> restored = restore(checkpoint, checkpoint.getType(i).name);
+			scripts.insert(scripts.end(), restored.begin(), restored.end());
+		}
+		return scripts;
+	}
+
+	std::vector<RestoredScript> ScriptCollection::restore(const Checkpoint& checkpoint, const std::string& name) {
+		std::vector<RestoredScript> scripts;
+
+		const CheckpointType* type = checkpoint.findType(name);
+		auto it = m_scripts.find(name);
+		if (!type || it == m_scripts.end()) {
+			printf("Skipping checkpointed script: %s\n", name.c_str());
+			return scripts;
+		}
+
+		const ScriptInterface& scriptInterface = it->second;
+		const CheckpointField* fields = checkpoint.getFields(*type);
+		const uint64_t* keys = checkpoint.getKeys(*type);
+		const Value* values = checkpoint.getValues(*type);
+		scripts.reserve(type->instanceCount);
+		m_instances.reserve(m_instances.size() + type->instanceCount);
+		m_instanceKeys.reserve(m_instanceKeys.size() + type->instanceCount);
+
+		// Keys must stay unique within the collection, instances whose key is already live are skipped
+		std::unordered_set<uint64_t> usedKeys;
+		usedKeys.reserve(m_instanceKeys.size());
+		for (const auto& [script, key] : m_instanceKeys) {
+			usedKeys.insert(key);
+		}
+
+		auto createWithKey = [&](uint64_t key) -> Script* {
+			if (!usedKeys.insert(key).second) {
+				printf("Skipping checkpointed %s, key %llu is already in use\n", name.c_str(), (unsigned long long)key);
+				return nullptr;
+			}
+
+			Script* script = createScript(name);
+			if (!script) {
+				return nullptr;
+			}
+			m_instanceKeys[script] = key;
+			m_nextInstanceKey = key >= m_nextInstanceKey ? key + 1 : m_nextInstanceKey;
+			scripts.push_back(RestoredScript{ key, script });
+			return script;
+		};
+
+		if (type->schemaHash == computeSchemaHash(scriptInterface) && type->fieldCount == scriptInterface.parameters.size()) {
+			// Same layout, values are applied straight from the mapping
+			size_t fieldCount = scriptInterface.parameters.size();
+			for (uint32_t i = 0; i < type->instanceCount; ++i) {
+				Script* script = createWithKey(keys[i]);
+				if (!script) {
+					continue;
+				}
+				const Value* row = values + (size_t)i * fieldCount;
+				for (size_t j = 0; j < fieldCount; ++j) {
+					scriptInterface.parameters[j].setValue(script, row[j]);
+				}
+			}
+			return scripts;
+		}
+
+		// Migrate by name, fields that no longer exist are dropped and new properties keep their defaults
+		std::vector<std::pair<uint32_t, const Parameter*>> mapping;
+		for (uint32_t i = 0; i < type->fieldCount; ++i) {
+			for (const Parameter& parameter : scriptInterface.parameters) {
+				if (parameter.name == fields[i].name) {
+					mapping.emplace_back(i, &parameter);
+					break;
+				}
+			}
+		}
+
+		for (uint32_t i = 0; i < type->instanceCount; ++i) {
+			Script* script = createWithKey(keys[i]);
+			if (!script) {
+				continue;
+			}
+			const Value* row = values + (size_t)i * type->fieldCount;
+			for (const auto& [field, parameter] : mapping) {
+				parameter->setValue(script, convertValue(row[field], fields[field].type, parameter->type));
+			}
+		}
+		return scripts;
+	}
+
+
+	const CheckpointType* Checkpoint::findType(const std::string& name) const {
+		for (uint32_t i = 0; i < getTypeCount(); ++i) {
+			if (name == getType(i).name) {
+				return &getType(i);
+			}
+		}
+		return nullptr;
+	}
+
+	// True if count elements of stride bytes starting at offset lie inside the file, without overflowing
+	static bool fits(uint64_t offset, uint64_t count, uint64_t stride, size_t size) {
+		return offset <= size && count <= (size - offset) / stride;
+	}
+
+	static bool validate(const char* data, size_t size) {
+		if (size < sizeof(CheckpointHeader)) {
+			return false;
+		}
+
+		const CheckpointHeader& header = *(const CheckpointHeader*)data;
+		if (header.magic != CHECKPOINT_MAGIC || header.version != CHECKPOINT_VERSION || header.size != size) {
+			return false;
+		}
+
+		if (!fits(sizeof(CheckpointHeader), header.typeCount, sizeof(CheckpointType), size)) {
+			return false;
+		}
+		uint64_t typesEnd = sizeof(CheckpointHeader) + (uint64_t)sizeof(CheckpointType) * header.typeCount;
+
+		const CheckpointType* types = (const CheckpointType*)(data + sizeof(CheckpointHeader));
+		for (uint32_t i = 0; i < header.typeCount; ++i) {
+			const CheckpointType& type = types[i];
+			uint64_t valueCount = (uint64_t)type.fieldCount * type.instanceCount;
+
+			if (memchr(type.name, '\0', CHECKPOINT_MAX_NAME) == nullptr
+				|| type.fieldOffset % 8 != 0 || type.keyOffset % 8 != 0 || type.valueOffset % 8 != 0
+				|| type.fieldOffset < typesEnd
+				|| !fits(type.fieldOffset, type.fieldCount, sizeof(CheckpointField), size)
+				|| !fits(type.keyOffset, type.instanceCount, sizeof(uint64_t), size)
+				|| !fits(type.valueOffset, valueCount, sizeof(Value), size)) {
+				return false;
+			}
+
+			// Offsets are known to be inside the file, the sums below can not overflow
+			uint64_t fieldsEnd = type.fieldOffset + (uint64_t)sizeof(CheckpointField) * type.fieldCount;
+			uint64_t keysEnd = type.keyOffset + (uint64_t)sizeof(uint64_t) * type.instanceCount;
+			if (fieldsEnd > type.keyOffset || keysEnd > type.valueOffset) {
+				return false;
+			}
+
+			const CheckpointField* fields = (const CheckpointField*)(data + type.fieldOffset);
+			for (uint32_t j = 0; j < type.fieldCount; ++j) {
+				if (memchr(fields[j].name, '\0', CHECKPOINT_MAX_NAME) == nullptr) {
+					return false;
+				}
+			}
+
+			// Keys are written sorted, 0 is never handed out since getInstanceKey uses it for unknown scripts
+			const uint64_t* keys = (const uint64_t*)(data + type.keyOffset);
+			for (uint32_t j = 0; j < type.instanceCount; ++j) {
+				if (keys[j] <= (j > 0 ? keys[j - 1] : 0)) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	std::shared_ptr<Checkpoint> Checkpoint::open(const std::string& path) {
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			printf("Failed to open checkpoint: %s\n", path.c_str());
+			return nullptr;
+		}
+
+		LARGE_INTEGER fileSize;
+		HANDLE mapping = NULL;
+		const char* data = nullptr;
+		if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+			mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		}
+		if (mapping) {
+			data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		}
+
+		auto checkpoint = std::make_shared<Checkpoint>(file, mapping, data, data ? (size_t)fileSize.QuadPart : 0);
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			printf("Failed to open checkpoint: %s\n", path.c_str());
+			return nullptr;
+		}
+
+		struct stat status;
+		const char* data = nullptr;
+		if (fstat(fd, &status) == 0 && status.st_size > 0) {
+			void* mapped = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (mapped != MAP_FAILED) {
+				data = (const char*)mapped;
+			}
+		}
+		close(fd);
+
+		auto checkpoint = std::make_shared<Checkpoint>(nullptr, nullptr, data, data ? (size_t)status.st_size : 0);
+#endif
+
+		if (!checkpoint->m_data || !validate(checkpoint->m_data, checkpoint->m_size)) {
+			printf("Invalid checkpoint: %s\n", path.c_str());
+			return nullptr;
+		}
+		return checkpoint;
+	}
+
+	Checkpoint::~Checkpoint() {
+#ifdef _WIN32
+		if (m_data) UnmapViewOfFile(m_data);
+		if (m_mapping) CloseHandle((HANDLE)m_mapping);
+		if (m_file) CloseHandle((HANDLE)m_file);
+#else
+		if (m_data) munmap((void*)m_data, m_size);
+#endif
+	}
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "ns.h"
+#include "loader.h"
+
+#include <string>
+#include <memory>
+#include <stdint.h>
+
+namespace ns {
+
+	constexpr uint32_t CHECKPOINT_MAGIC = 0x4E534350; // "NSCP"
+	constexpr uint32_t CHECKPOINT_VERSION = 2;
+	constexpr uint32_t CHECKPOINT_MAX_NAME = 64;
+
+	// File layout, all offsets are from the start of the file and 8 byte aligned:
+	//  CheckpointHeader
+	//  CheckpointType[typeCount]
+	//  per type: CheckpointField[fieldCount], uint64_t key[instanceCount], Value[instanceCount * fieldCount]
+	// Instances are sorted by key, values are stored instance by instance in field order, in native byte order.
+	// Names must be shorter than CHECKPOINT_MAX_NAME, checkpointing fails otherwise.
+	struct CheckpointHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t typeCount;
+		uint32_t reserved;
+		uint64_t size;
+	};
+
+	struct CheckpointType {
+		char name[CHECKPOINT_MAX_NAME];
+		uint64_t schemaHash;
+		uint32_t fieldCount;
+		uint32_t instanceCount;
+		uint64_t fieldOffset;
+		uint64_t keyOffset;
+		uint64_t valueOffset;
+	};
+
+	struct CheckpointField {
+		char name[CHECKPOINT_MAX_NAME];
+		ParameterType type;
+		uint32_t reserved;
+	};
+
+	// Hash of the script name and the name and type of every property, in declaration order
+	uint64_t computeSchemaHash(const ScriptInterface& script);
+
+	// Read only mapping of a checkpoint file. Nothing is copied on open, value pages
+	// of a type are only touched once its instances are restored.
+	class Checkpoint {
+	public:
+		Checkpoint(void* file, void* mapping, const char* data, size_t size)
+			: m_file(file), m_mapping(mapping), m_data(data), m_size(size) {}
+		~Checkpoint();
+
+		Checkpoint(const Checkpoint&) = delete;
+		Checkpoint& operator=(const Checkpoint&) = delete;
+
+		uint32_t getTypeCount() const { return getHeader().typeCount; }
+		const CheckpointType& getType(uint32_t index) const { return ((const CheckpointType*)(m_data + sizeof(CheckpointHeader)))[index]; }
+		const CheckpointType* findType(const std::string& name) const;
+
+		const CheckpointField* getFields(const CheckpointType& type) const { return (const CheckpointField*)(m_data + type.fieldOffset); }
+		const uint64_t* getKeys(const CheckpointType& type) const { return (const uint64_t*)(m_data + type.keyOffset); }
+		const Value* getValues(const CheckpointType& type) const { return (const Value*)(m_data + type.valueOffset); }
+
+		// Maps the file and validates the layout, returns nullptr if the file is not a usable checkpoint
+		static std::shared_ptr<Checkpoint> open(const std::string& path);
+
+	private:
+		const CheckpointHeader& getHeader() const { return *(const CheckpointHeader*)m_data; }
+
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+		const char* m_data = nullptr;
+		size_t m_size = 0;
+	};
+
+}
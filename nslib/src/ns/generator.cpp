@@ -76,12 +76,40 @@ namespace ns {
 	}
 
 	void outputScript(std::ostream& out, const ScriptInfo& script) {
-		out << "extern \"C\" NS_EXPORT " << script.name << "* create" << script.name << "() {\n";
-		out << "	return new " << script.name << "();\n";
+		std::string allocator = "s_" + script.name + "Allocator";
+		out << "static ns::ScriptAllocator " << allocator << ";\n\n";
+
+		out << "extern \"C\" NS_EXPORT " << script.name << "* " << script.nameCreateFn << "() {\n";
+		out << "	" << script.name << "* x;\n";
+		out << "	if (" << allocator << ".allocate) {\n";
+		out << "		void* memory = " << allocator << ".allocate(" << allocator << ".userData, sizeof(" << script.name << "));\n";
+		out << "		if (!memory) return nullptr;\n";
+		out << "		x = new (memory) " << script.name << "();\n";
+		out << "	}\n";
+		out << "	else {\n";
+		out << "		x = new " << script.name << "();\n";
+		out << "	}\n";
+		out << "	if (" << allocator << ".onCreated) " << allocator << ".onCreated(" << allocator << ".countType);\n";
+		out << "	return x;\n";
 		out << "}\n\n";
 
-		out << "extern \"C\" NS_EXPORT void destroy" << script.name << "(" << script.name << "* x) {\n";
-		out << "	delete x;\n";
+		out << "extern \"C\" NS_EXPORT void " << script.nameDestroyFn << "(" << script.name << "* x) {\n";
+		out << "	if (" << allocator << ".free) {\n";
+		out << "		x->~" << script.name << "();\n";
+		out << "		" << allocator << ".free(" << allocator << ".userData, x);\n";
+		out << "	}\n";
+		out << "	else {\n";
+		out << "		delete x;\n";
+		out << "	}\n";
+		out << "	if (" << allocator << ".onDestroyed) " << allocator << ".onDestroyed(" << allocator << ".countType);\n";
+		out << "}\n\n";
+
+		out << "extern \"C\" NS_EXPORT size_t " << script.nameSizeFn << "() {\n";
+		out << "	return sizeof(" << script.name << ");\n";
+		out << "}\n\n";
+
+		out << "extern \"C\" NS_EXPORT void " << script.nameSetAllocatorFn << "(ns::ScriptAllocator allocator) {\n";
+		out << "	" << allocator << " = allocator;\n";
 		out << "}\n";
 
 		for (const ParameterInfo& parameter : script.parameters) {
@@ -125,7 +153,9 @@ namespace ns {
 		out << rowStart << "	},\n";
 
 		out << rowStart << "	\"" << script.nameCreateFn << "\",\n";
-		out << rowStart << "	\"" << script.nameDestroyFn << "\"\n";
+		out << rowStart << "	\"" << script.nameDestroyFn << "\",\n";
+		out << rowStart << "	\"" << script.nameSizeFn << "\",\n";
+		out << rowStart << "	\"" << script.nameSetAllocatorFn << "\"\n";
 		out << rowStart << "}";
 	}
 
@@ -142,6 +172,8 @@ namespace ns {
 				scriptInfo.name = (++it)->lexeme;
 				scriptInfo.nameCreateFn = "create" + scriptInfo.name;
 				scriptInfo.nameDestroyFn = "destroy" + scriptInfo.name;
+				scriptInfo.nameSizeFn = "sizeof" + scriptInfo.name;
+				scriptInfo.nameSetAllocatorFn = "setAllocator" + scriptInfo.name;
 
 				// Find all properties
 				while (it != tokens.end() && it->type != TokenType::CLASS_PROP) {
@@ -172,15 +204,16 @@ namespace ns {
 		return scripts;
 	}
 
-	void processHeaderFile(fs::path filePath, const fs::path& projectRoot, const fs::path& outputRoot, std::vector<ScriptInfo>& projectScripts) {
-		std::string content;
-		std::getline(std::ifstream(filePath), content, '\0');
+	fs::path getOutputPath(fs::path filePath, const fs::path& projectRoot, const fs::path& outputRoot) {
+		filePath.replace_extension("generated" + filePath.extension().generic_string());
+		return outputRoot / filePath.lexically_relative(projectRoot);
+	}
 
+	std::vector<ScriptInfo> processHeaderFile(const fs::path& filePath, const std::string& content, const fs::path& projectRoot, const fs::path& outputRoot) {
 		std::vector<Token> tokens = lex(content);
 		std::vector<ScriptInfo> scripts = parseTokens(tokens);
 
-		filePath.replace_extension("generated" + filePath.extension().generic_string());
-		fs::path newPath = outputRoot / filePath.lexically_relative(projectRoot);
+		fs::path newPath = getOutputPath(filePath, projectRoot, outputRoot);
 		fs::create_directories(newPath.parent_path());
 
 		std::ofstream out(newPath);
@@ -191,40 +224,26 @@ namespace ns {
 			outputScript(out, script);
 		}
 
-		projectScripts.insert(projectScripts.end(), scripts.begin(), scripts.end());
+		return scripts;
 	}
 
-	void processSourceFile(fs::path filePath, const fs::path& projectRoot, const fs::path& outputRoot) {
-		std::string content;
-		std::getline(std::ifstream(filePath), content, '\0');
-
+	void processSourceFile(const fs::path& filePath, const std::string& content, const fs::path& projectRoot, const fs::path& outputRoot) {
 		std::string originalName = filePath.stem().generic_string() + ".h";
 		std::string headerName = filePath.stem().generic_string() + ".generated.h";
 
-		filePath.replace_extension("generated" + filePath.extension().generic_string());
-		fs::path newPath = outputRoot / filePath.lexically_relative(projectRoot);
+		fs::path newPath = getOutputPath(filePath, projectRoot, outputRoot);
 		fs::create_directories(newPath.parent_path());
 
 		std::ofstream out(newPath);
 		out << std::regex_replace(content, std::regex(originalName), headerName);
 	}
 
-	void processDirectory(fs::path path, const fs::path& projectRoot, const fs::path& outputRoot, std::vector<ScriptInfo>& projectScripts) {
-		for (const auto& entry : fs::directory_iterator(path)) {
-			fs::path entryPath = fs::absolute(entry.path());
+	bool isHeaderFile(const fs::path& path) {
+		return isIn(path.extension(), ".h", ".hpp");
+	}
 
-			if (entry.is_regular_file()) {
-				if (isIn(entryPath.extension(), ".h", ".hpp")) {
-					processHeaderFile(entryPath, projectRoot, outputRoot, projectScripts);
-				}
-				else if (isIn(entryPath.extension(), ".cpp", ".cc", ".cxx")) {
-					processSourceFile(entryPath, projectRoot, outputRoot);
-				}
-			}
-			else if (entry.is_directory()) {
-				processDirectory(entryPath, projectRoot, outputRoot, projectScripts);
-			}
-		}
+	bool isSourceFile(const fs::path& path) {
+		return isIn(path.extension(), ".cpp", ".cc", ".cxx");
 	}
 
 	void generateScriptsHeader(const fs::path& outputRoot, const std::vector<ScriptInfo>& projectScripts) {
@@ -256,12 +275,72 @@ namespace ns {
 
 	}
 
-	void generateProject(const char* path, const char* outputPath) {
+	ProjectGenerator::ProjectGenerator(const std::string& path, const std::string& outputPath)
+		: m_projectRoot(fs::absolute(path)), m_outputRoot(fs::absolute(outputPath)) {}
+
+	bool ProjectGenerator::isProjectFile(const std::string& filePath) {
+		return isHeaderFile(filePath) || isSourceFile(filePath);
+	}
+
+	void ProjectGenerator::generate() {
+		m_files.clear();
+
+		for (const auto& entry : fs::recursive_directory_iterator(m_projectRoot)) {
+			if (entry.is_regular_file() && isProjectFile(entry.path().generic_string())) {
+				updateFile(fs::absolute(entry.path()).generic_string());
+			}
+		}
+
+		writeScripts();
+	}
+
+	bool ProjectGenerator::updateFile(const std::string& filePath) {
+		std::string content;
+		if (!std::getline(std::ifstream(filePath), content, '\0') && !fs::exists(filePath)) {
+			removeFile(filePath);
+			return true;
+		}
+
+		// Editors often save without changes, skip those to keep the output untouched
+		size_t contentHash = std::hash<std::string>()(content);
+		auto it = m_files.find(filePath);
+		if (it != m_files.end() && it->second.contentHash == contentHash) {
+			return false;
+		}
+
+		FileState state;
+		state.contentHash = contentHash;
+		if (isHeaderFile(filePath)) {
+			state.scripts = processHeaderFile(filePath, content, m_projectRoot, m_outputRoot);
+		}
+		else {
+			processSourceFile(filePath, content, m_projectRoot, m_outputRoot);
+		}
+
+		m_files[filePath] = state;
+		return true;
+	}
+
+	void ProjectGenerator::removeFile(const std::string& filePath) {
+		if (m_files.erase(filePath) > 0) {
+			std::error_code error;
+			fs::remove(getOutputPath(filePath, m_projectRoot, m_outputRoot), error);
+		}
+	}
+
+	void ProjectGenerator::writeScripts() const {
 		std::vector<ScriptInfo> projectScripts;
+		for (const auto& [filePath, state] : m_files) {
+			projectScripts.insert(projectScripts.end(), state.scripts.begin(), state.scripts.end());
+		}
 
-		processDirectory(path, path, outputPath, projectScripts);
+		fs::create_directories(m_outputRoot);
+		generateScriptsHeader(m_outputRoot, projectScripts);
+	}
 
-		generateScriptsHeader(outputPath, projectScripts);
+	void generateProject(const char* path, const char* outputPath) {
+		ProjectGenerator generator(path, outputPath);
+		generator.generate();
 	}
 
 }
@@ -1,5 +1,44 @@
 #pragma once
 
+#include "ns.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <filesystem>
+
 namespace ns {
+
+	// Keeps the parsed scripts of every project file so single files can be regenerated
+	class ProjectGenerator {
+	public:
+		ProjectGenerator(const std::string& path, const std::string& outputPath);
+
+		// Processes every file in the project and writes scripts.generated.*
+		void generate();
+
+		// Regenerates the output of one file, returns false if its content did not change.
+		// Files that no longer exist are removed. Call writeScripts() afterwards.
+		bool updateFile(const std::string& filePath);
+		void removeFile(const std::string& filePath);
+		void writeScripts() const;
+
+		const std::filesystem::path& getProjectRoot() const { return m_projectRoot; }
+		size_t getFileCount() const { return m_files.size(); }
+
+		static bool isProjectFile(const std::string& filePath);
+
+	private:
+		struct FileState {
+			size_t contentHash = 0;
+			std::vector<ScriptInfo> scripts;
+		};
+
+		std::filesystem::path m_projectRoot;
+		std::filesystem::path m_outputRoot;
+
+		std::map<std::string, FileState> m_files;
+	};
+
 	void generateProject(const char* path, const char* outputPath);
 }
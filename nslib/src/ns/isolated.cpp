@@ -0,0 +1,520 @@
+#include "isolated.h"
+
+#include <new>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <spawn.h>
+	#include <signal.h>
+	#include <sys/wait.h>
+	#include <unistd.h>
+
+	extern char** environ;
+#endif
+
+namespace ns {
+
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr int SPIN_COUNT = 4096;
+
+	static std::string makeMemoryName() {
+		static std::atomic<int> s_counter = 0;
+#ifdef _WIN32
+		return "Local\\ns-host-" + std::to_string(GetCurrentProcessId()) + "-" + std::to_string(s_counter++);
+#else
+		return "/ns-host-" + std::to_string(getpid()) + "-" + std::to_string(s_counter++);
+#endif
+	}
+
+	static void* spawnHost(const std::string& hostPath, const std::string& libraryPath, const std::string& memoryName) {
+#ifdef _WIN32
+		std::string commandLine = "\"" + hostPath + "\" \"" + libraryPath + "\" \"" + memoryName + "\"";
+
+		STARTUPINFOA startupInfo = {};
+		startupInfo.cb = sizeof(startupInfo);
+		PROCESS_INFORMATION processInfo = {};
+		if (!CreateProcessA(NULL, commandLine.data(), NULL, NULL, FALSE, 0, NULL, NULL, &startupInfo, &processInfo)) {
+			printf("Failed to start script host. Error code: %ld\n", GetLastError());
+			return nullptr;
+		}
+		CloseHandle(processInfo.hThread);
+		return processInfo.hProcess;
+#else
+		char* arguments[] = { (char*)hostPath.c_str(), (char*)libraryPath.c_str(), (char*)memoryName.c_str(), nullptr };
+
+		pid_t pid;
+		int result = posix_spawnp(&pid, hostPath.c_str(), nullptr, nullptr, arguments, environ);
+		if (result != 0) {
+			printf("Failed to start script host: %s\n", strerror(result));
+			return nullptr;
+		}
+		return (void*)(intptr_t)pid;
+#endif
+	}
+
+	static bool isProcessAlive(void* process) {
+#ifdef _WIN32
+		return WaitForSingleObject((HANDLE)process, 0) == WAIT_TIMEOUT;
+#else
+		int status;
+		return waitpid((pid_t)(intptr_t)process, &status, WNOHANG) == 0;
+#endif
+	}
+
+	static void killProcess(void* process) {
+#ifdef _WIN32
+		TerminateProcess((HANDLE)process, 1);
+		WaitForSingleObject((HANDLE)process, INFINITE);
+#else
+		kill((pid_t)(intptr_t)process, SIGKILL);
+		int status;
+		waitpid((pid_t)(intptr_t)process, &status, 0);
+#endif
+	}
+
+	// Releases a process that has exited or was killed
+	static void closeProcess(void* process) {
+#ifdef _WIN32
+		CloseHandle((HANDLE)process);
+#else
+		(void)process;
+#endif
+	}
+
+	// Spins first since commands usually arrive in bursts, then backs off to not burn a core while idle
+	static void backoff(int& spins) {
+		if (++spins < SPIN_COUNT) {
+			std::this_thread::yield();
+		}
+		else {
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+	}
+
+	// Returns false if the process is still running after the timeout
+	static bool waitProcess(void* process, uint32_t timeoutMs) {
+#ifdef _WIN32
+		return WaitForSingleObject((HANDLE)process, timeoutMs) == WAIT_OBJECT_0;
+#else
+		Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+		int spins = 0;
+		while (isProcessAlive(process)) {
+			if (Clock::now() >= deadline) {
+				return false;
+			}
+			backoff(spins);
+		}
+		return true;
+#endif
+	}
+
+
+	std::shared_ptr<IsolatedScriptCollection> IsolatedScriptCollection::create(const std::string& path, const std::string& hostPath, uint32_t slotCapacity) {
+		std::string memoryName = makeMemoryName();
+		auto memory = SharedMemory::create(memoryName, sizeof(IsolatedHeader) + (size_t)slotCapacity * sizeof(Value));
+		if (!memory) {
+			return nullptr;
+		}
+
+		IsolatedHeader* header = new (memory->getData()) IsolatedHeader();
+		header->magic = ISOLATED_MAGIC;
+		header->version = ISOLATED_VERSION;
+		header->slotCapacity = slotCapacity;
+#ifdef _WIN32
+		header->hostProcess = GetCurrentProcessId();
+#else
+		header->hostProcess = (uint32_t)getpid();
+#endif
+		header->state.store((uint32_t)IsolatedState::STARTING, std::memory_order_release);
+
+		void* process = spawnHost(hostPath, path, memoryName);
+		if (!process) {
+			return nullptr;
+		}
+
+		// Wait for the worker to load the library and publish its metadata, static initializers of the library may hang
+		Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(ISOLATED_TIMEOUT_MS);
+		int spins = 0;
+		uint32_t state;
+		while ((state = header->state.load(std::memory_order_acquire)) == (uint32_t)IsolatedState::STARTING) {
+			if (spins % 256 == 0) {
+				if (!isProcessAlive(process)) {
+					printf("Script host exited during startup\n");
+					memory->unlink();
+					closeProcess(process);
+					return nullptr;
+				}
+				if (Clock::now() >= deadline) {
+					printf("Script host did not start within %u ms, killing it\n", ISOLATED_TIMEOUT_MS);
+					killProcess(process);
+					memory->unlink();
+					closeProcess(process);
+					return nullptr;
+				}
+			}
+			backoff(spins);
+		}
+
+		// Both sides have the region mapped, nothing else needs to find it
+		memory->unlink();
+
+		if (state != (uint32_t)IsolatedState::READY) {
+			printf("Script host failed to load library: %s\n", path.c_str());
+			if (!waitProcess(process, ISOLATED_TIMEOUT_MS)) {
+				killProcess(process);
+			}
+			closeProcess(process);
+			return nullptr;
+		}
+
+		std::vector<IsolatedScript> scripts(header->scriptCount);
+		for (uint32_t i = 0; i < header->scriptCount; ++i) {
+			const IsolatedScriptEntry& entry = header->scripts[i];
+			scripts[i].name = entry.name;
+
+			for (uint32_t j = 0; j < entry.parameterCount; ++j) {
+				const IsolatedParameterEntry& parameter = header->parameters[entry.firstParameter + j];
+				scripts[i].parameters.push_back(IsolatedParameter{ parameter.name, parameter.type });
+			}
+		}
+
+		return std::make_shared<IsolatedScriptCollection>(memory, process, scripts);
+	}
+
+	IsolatedScriptCollection::~IsolatedScriptCollection() {
+		// The worker exits once it has processed the remaining commands
+		if (m_alive && submit(Command{ CommandType::SHUTDOWN, 0, 0, 0 })) {
+			if (waitProcess(m_process, ISOLATED_TIMEOUT_MS)) {
+				m_alive = false;
+			}
+			else {
+				printf("Script host did not shut down, killing it\n");
+				kill();
+			}
+		}
+		closeProcess(m_process);
+	}
+
+	int IsolatedScriptCollection::getScriptIndex(const std::string& name) const {
+		for (size_t i = 0; i < m_scripts.size(); ++i) {
+			if (m_scripts[i].name == name) {
+				return (int)i;
+			}
+		}
+		return -1;
+	}
+
+	int IsolatedScriptCollection::createScript(int script) {
+		if (!m_alive || script < 0 || script >= (int)m_scripts.size()) {
+			return -1;
+		}
+
+		// Instances of the same script have the same slot count so freed runs can be reused as is
+		uint32_t slotCount = (uint32_t)m_scripts[script].parameters.size();
+		if (m_freeSlots.size() < m_scripts.size()) {
+			m_freeSlots.resize(m_scripts.size());
+		}
+
+		uint32_t slot;
+		if (!m_freeSlots[script].empty()) {
+			slot = m_freeSlots[script].back();
+			m_freeSlots[script].pop_back();
+		}
+		else if (m_nextSlot + slotCount <= m_header->slotCapacity) {
+			slot = m_nextSlot;
+			m_nextSlot += slotCount;
+		}
+		else {
+			printf("Script host is out of property slots\n");
+			return -1;
+		}
+
+		int instance;
+		if (!m_freeInstances.empty()) {
+			instance = m_freeInstances.back();
+			m_freeInstances.pop_back();
+		}
+		else if (m_instances.size() == ISOLATED_MAX_INSTANCES) {
+			printf("Script host is out of instances\n");
+			m_freeSlots[script].push_back(slot);
+			return -1;
+		}
+		else {
+			instance = (int)m_instances.size();
+			m_instances.emplace_back();
+		}
+		m_instances[instance] = Instance{ script, slot };
+
+		if (!submit(Command{ CommandType::CREATE, (uint32_t)instance, (uint32_t)script, slot })) {
+			// Never reached the worker, hand the id and slots back
+			m_instances[instance] = Instance{};
+			m_freeSlots[script].push_back(slot);
+			m_freeInstances.push_back(instance);
+			return -1;
+		}
+		return instance;
+	}
+
+	void IsolatedScriptCollection::startScript(int instance) {
+		if (isValidInstance(instance)) {
+			submit(Command{ CommandType::START, (uint32_t)instance, 0, 0 });
+		}
+	}
+
+	void IsolatedScriptCollection::updateScript(int instance) {
+		if (isValidInstance(instance)) {
+			submit(Command{ CommandType::UPDATE, (uint32_t)instance, 0, 0 });
+		}
+	}
+
+	void IsolatedScriptCollection::destroyScript(int instance) {
+		if (!isValidInstance(instance) || !submit(Command{ CommandType::DESTROY, (uint32_t)instance, 0, 0 })) {
+			return;
+		}
+
+		Instance& data = m_instances[instance];
+		m_freeSlots[data.script].push_back(data.slot);
+		m_freeInstances.push_back(instance);
+		data = Instance{};
+	}
+
+	bool IsolatedScriptCollection::flush(uint32_t timeoutMs) {
+		Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+		int spins = 0;
+		while (m_alive && m_header->completed.load(std::memory_order_acquire) != m_submitted) {
+			if (spins % 256 == 0 && !checkWorker(deadline)) {
+				break;
+			}
+			backoff(spins);
+		}
+		return m_alive;
+	}
+
+	bool IsolatedScriptCollection::checkWorker(Clock::time_point deadline) {
+		if (!isAlive()) {
+			return false;
+		}
+		if (Clock::now() >= deadline) {
+			printf("Script host stopped responding, killing it\n");
+			kill();
+			return false;
+		}
+		return true;
+	}
+
+	void IsolatedScriptCollection::kill() {
+		killProcess(m_process);
+		m_alive = false;
+	}
+
+	bool IsolatedScriptCollection::isAlive() {
+		if (m_alive && !isProcessAlive(m_process)) {
+			printf("Script host terminated unexpectedly\n");
+			m_alive = false;
+		}
+		return m_alive;
+	}
+
+	bool IsolatedScriptCollection::submit(const Command& command) {
+		Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(ISOLATED_TIMEOUT_MS);
+		int spins = 0;
+		while (m_alive && !m_header->ring.push(command)) {
+			if (spins % 256 == 0 && !checkWorker(deadline)) {
+				break;
+			}
+			backoff(spins);
+		}
+
+		if (m_alive) {
+			++m_submitted;
+		}
+		return m_alive;
+	}
+
+
+	// Truncated names could collide in getScriptIndex, longer names are rejected
+	static bool copyString(char* destination, const std::string& source) {
+		if (source.size() >= ISOLATED_MAX_NAME) {
+			printf("Name too long for the script host: %s\n", source.c_str());
+			return false;
+		}
+		memcpy(destination, source.c_str(), source.size() + 1);
+		return true;
+	}
+
+	int runIsolatedHost(const std::string& libraryPath, const std::string& memoryName) {
+		auto memory = SharedMemory::open(memoryName);
+		if (!memory || memory->getSize() < sizeof(IsolatedHeader)) {
+			return 1;
+		}
+
+		IsolatedHeader* header = (IsolatedHeader*)memory->getData();
+		if (header->magic != ISOLATED_MAGIC || header->version != ISOLATED_VERSION
+			|| memory->getSize() < sizeof(IsolatedHeader) + (size_t)header->slotCapacity * sizeof(Value)) {
+			printf("Script host version mismatch\n");
+			header->state.store((uint32_t)IsolatedState::FAILED, std::memory_order_release);
+			return 1;
+		}
+
+		auto collection = ScriptCollection::create(libraryPath);
+		if (!collection) {
+			header->state.store((uint32_t)IsolatedState::FAILED, std::memory_order_release);
+			return 1;
+		}
+
+		// Publish metadata, script indices used in commands refer to this order
+		std::vector<const ScriptInterface*> interfaces;
+		uint32_t parameterCount = 0;
+		for (const auto& [name, script] : collection->getScripts()) {
+			if (interfaces.size() == ISOLATED_MAX_SCRIPTS || parameterCount + script.parameters.size() > ISOLATED_MAX_PARAMETERS) {
+				printf("Script library exceeds script host limits\n");
+				header->state.store((uint32_t)IsolatedState::FAILED, std::memory_order_release);
+				return 1;
+			}
+
+			IsolatedScriptEntry& entry = header->scripts[interfaces.size()];
+			bool namesFit = copyString(entry.name, name);
+			entry.parameterCount = (uint32_t)script.parameters.size();
+			entry.firstParameter = parameterCount;
+
+			for (const Parameter& parameter : script.parameters) {
+				IsolatedParameterEntry& parameterEntry = header->parameters[parameterCount++];
+				namesFit = copyString(parameterEntry.name, parameter.name) && namesFit;
+				parameterEntry.type = parameter.type;
+			}
+
+			if (!namesFit) {
+				header->state.store((uint32_t)IsolatedState::FAILED, std::memory_order_release);
+				return 1;
+			}
+
+			interfaces.push_back(&script);
+		}
+		header->scriptCount = (uint32_t)interfaces.size();
+		header->parameterCount = parameterCount;
+		header->state.store((uint32_t)IsolatedState::READY, std::memory_order_release);
+
+		struct Instance {
+			Script* script = nullptr;
+			const ScriptInterface* scriptInterface = nullptr;
+			uint32_t slot = 0;
+		};
+		std::vector<Instance> instances;
+
+		Value* slots = header->getSlots();
+#ifdef _WIN32
+		HANDLE host = OpenProcess(SYNCHRONIZE, FALSE, header->hostProcess);
+#endif
+
+		int spins = 0;
+		bool running = true;
+		while (running) {
+			Command command;
+			if (!header->ring.pop(command)) {
+				// NOTE: Exit with the host, the region would otherwise keep the worker waiting forever
+				if (spins % 256 == 0) {
+#ifdef _WIN32
+					if (!host || WaitForSingleObject(host, 0) != WAIT_TIMEOUT) {
+						break;
+					}
+#else
+					if (getppid() != (pid_t)header->hostProcess) {
+						break;
+					}
+#endif
+				}
+				backoff(spins);
+				continue;
+			}
+			spins = 0;
+
+			// Commands come from another process, never trust the indices
+			bool valid;
+			if (command.type == CommandType::CREATE) {
+				valid = command.script < interfaces.size() && command.instance < ISOLATED_MAX_INSTANCES
+					&& (command.instance >= instances.size() || !instances[command.instance].script)
+					&& (uint64_t)command.slot + interfaces[command.script]->parameters.size() <= header->slotCapacity;
+			}
+			else {
+				valid = command.type == CommandType::SHUTDOWN
+					|| (command.instance < instances.size() && instances[command.instance].script);
+			}
+			if (!valid) {
+				printf("Script host ignored an invalid command\n");
+				header->completed.fetch_add(1, std::memory_order_release);
+				continue;
+			}
+
+			if (command.type == CommandType::CREATE) {
+				if (command.instance >= instances.size()) {
+					instances.resize((size_t)command.instance + 1);
+				}
+
+				const ScriptInterface* scriptInterface = interfaces[command.script];
+				Script* script = scriptInterface->createScriptFunc();
+				if (!script) {
+					// Later commands for the instance are ignored as invalid
+					printf("Script host failed to allocate a script\n");
+					header->completed.fetch_add(1, std::memory_order_release);
+					continue;
+				}
+				instances[command.instance] = Instance{ script, scriptInterface, command.slot };
+
+				for (size_t i = 0; i < scriptInterface->parameters.size(); ++i) {
+					slots[command.slot + i] = scriptInterface->parameters[i].getValue(script);
+				}
+			}
+			else if (command.type == CommandType::SHUTDOWN) {
+				running = false;
+			}
+			else {
+				Instance& instance = instances[command.instance];
+				const auto& parameters = instance.scriptInterface->parameters;
+
+				if (command.type == CommandType::DESTROY) {
+					instance.scriptInterface->destroyScriptFunc(instance.script);
+					instance = Instance{};
+				}
+				else {
+					// Values may have been written by the host since the last command
+					for (size_t i = 0; i < parameters.size(); ++i) {
+						parameters[i].setValue(instance.script, slots[instance.slot + i]);
+					}
+
+					if (command.type == CommandType::START) {
+						instance.script->start();
+					}
+					else {
+						instance.script->update();
+					}
+
+					for (size_t i = 0; i < parameters.size(); ++i) {
+						slots[instance.slot + i] = parameters[i].getValue(instance.script);
+					}
+				}
+			}
+
+			header->completed.fetch_add(1, std::memory_order_release);
+		}
+
+		for (Instance& instance : instances) {
+			if (instance.script) {
+				instance.scriptInterface->destroyScriptFunc(instance.script);
+			}
+		}
+		header->state.store((uint32_t)IsolatedState::STOPPED, std::memory_order_release);
+#ifdef _WIN32
+		if (host) CloseHandle(host);
+#endif
+
+		return 0;
+	}
+
+}
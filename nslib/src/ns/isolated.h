@@ -0,0 +1,186 @@
+#pragma once
+
+#include "ns.h"
+#include "loader.h"
+#include "shared_memory.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+namespace ns {
+
+	constexpr uint32_t ISOLATED_MAGIC = 0x4E534850; // "NSHP"
+	constexpr uint32_t ISOLATED_VERSION = 2;
+
+	constexpr uint32_t ISOLATED_MAX_NAME = 64;
+	constexpr uint32_t ISOLATED_MAX_SCRIPTS = 256;
+	constexpr uint32_t ISOLATED_MAX_PARAMETERS = 4096;
+	constexpr uint32_t ISOLATED_MAX_INSTANCES = 1 << 20;
+	constexpr uint32_t ISOLATED_RING_SIZE = 4096; // Must be a power of two
+	constexpr uint32_t ISOLATED_TIMEOUT_MS = 5000;
+
+	static_assert(std::atomic<uint32_t>::is_always_lock_free, "Shared memory requires lock free atomics");
+	static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared memory requires lock free atomics");
+
+	enum class IsolatedState : uint32_t {
+		STARTING	= 0,
+		READY		= 1,
+		FAILED		= 2,
+		STOPPED		= 3
+	};
+
+	enum class CommandType : uint32_t {
+		CREATE		= 0,
+		START		= 1,
+		UPDATE		= 2,
+		DESTROY		= 3,
+		SHUTDOWN	= 4
+	};
+
+	struct Command {
+		CommandType type;
+		uint32_t instance;
+		uint32_t script;
+		uint32_t slot;
+	};
+
+	// Single producer (host) single consumer (worker) ring living in shared memory
+	struct CommandRing {
+		alignas(64) std::atomic<uint32_t> head;
+		alignas(64) std::atomic<uint32_t> tail;
+		alignas(64) Command commands[ISOLATED_RING_SIZE];
+
+		bool push(const Command& command) {
+			uint32_t t = tail.load(std::memory_order_relaxed);
+			if (t - head.load(std::memory_order_acquire) == ISOLATED_RING_SIZE) {
+				return false;
+			}
+			commands[t & (ISOLATED_RING_SIZE - 1)] = command;
+			tail.store(t + 1, std::memory_order_release);
+			return true;
+		}
+
+		bool pop(Command& command) {
+			uint32_t h = head.load(std::memory_order_relaxed);
+			if (h == tail.load(std::memory_order_acquire)) {
+				return false;
+			}
+			command = commands[h & (ISOLATED_RING_SIZE - 1)];
+			head.store(h + 1, std::memory_order_release);
+			return true;
+		}
+	};
+
+	struct IsolatedScriptEntry {
+		char name[ISOLATED_MAX_NAME];
+		uint32_t parameterCount;
+		uint32_t firstParameter;
+	};
+
+	struct IsolatedParameterEntry {
+		char name[ISOLATED_MAX_NAME];
+		ParameterType type;
+	};
+
+	// Start of the shared region, followed by slotCapacity Values, one per UPROPERTY.
+	// Instances of a script own a contiguous run of slots.
+	// The host fills in the capacities, the worker fills in the script metadata.
+	struct IsolatedHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t slotCapacity;
+		uint32_t scriptCount;
+		uint32_t parameterCount;
+		uint32_t hostProcess; // Process id of the host, the worker exits once it is gone
+
+		std::atomic<uint32_t> state;
+		alignas(64) std::atomic<uint64_t> completed;
+
+		IsolatedScriptEntry scripts[ISOLATED_MAX_SCRIPTS];
+		IsolatedParameterEntry parameters[ISOLATED_MAX_PARAMETERS];
+
+		CommandRing ring;
+
+		Value* getSlots() { return (Value*)(this + 1); }
+	};
+
+	struct IsolatedParameter {
+		std::string name;
+		ParameterType type = ParameterType::ERROR_T;
+	};
+
+	struct IsolatedScript {
+		std::string name;
+		std::vector<IsolatedParameter> parameters;
+	};
+
+	// Runs the scripts of a library inside a separate ns-host process. Commands are queued
+	// without waiting, property values live in shared memory and can be read and written
+	// directly once flush() has returned.
+	class IsolatedScriptCollection {
+	public:
+		IsolatedScriptCollection(std::shared_ptr<SharedMemory> memory, void* process, const std::vector<IsolatedScript>& scripts)
+			: m_memory(memory), m_header((IsolatedHeader*)memory->getData()), m_process(process), m_scripts(scripts) {}
+		~IsolatedScriptCollection();
+
+		IsolatedScriptCollection(const IsolatedScriptCollection&) = delete;
+		IsolatedScriptCollection& operator=(const IsolatedScriptCollection&) = delete;
+
+		const std::vector<IsolatedScript>& getScripts() const { return m_scripts; }
+		int getScriptIndex(const std::string& name) const;
+
+		// Returns an instance id or -1 on failure
+		int createScript(int script);
+		void startScript(int instance);
+		void updateScript(int instance);
+		void destroyScript(int instance);
+
+		// Waits for the worker to finish all queued commands. Returns false if the worker has died,
+		// a worker that does not catch up within the timeout is killed.
+		bool flush(uint32_t timeoutMs = ISOLATED_TIMEOUT_MS);
+		bool isAlive();
+
+		// Returns nullptr for unknown instances and parameters
+		Value* getValue(int instance, int parameter) {
+			if (!isValidInstance(instance) || parameter < 0 || parameter >= (int)m_scripts[m_instances[instance].script].parameters.size()) {
+				return nullptr;
+			}
+			return &m_header->getSlots()[m_instances[instance].slot + parameter];
+		}
+
+		static std::shared_ptr<IsolatedScriptCollection> create(const std::string& path, const std::string& hostPath = "ns-host", uint32_t slotCapacity = 1 << 20);
+
+	private:
+		struct Instance {
+			int script = -1;
+			uint32_t slot = 0;
+		};
+
+		bool isValidInstance(int instance) const { return instance >= 0 && instance < (int)m_instances.size() && m_instances[instance].script >= 0; }
+		bool submit(const Command& command);
+		// Called while waiting on the worker, returns false once it died or was killed for missing the deadline
+		bool checkWorker(std::chrono::steady_clock::time_point deadline);
+		void kill();
+
+		std::shared_ptr<SharedMemory> m_memory;
+		IsolatedHeader* m_header = nullptr;
+		void* m_process = nullptr;
+		bool m_alive = true;
+
+		std::vector<IsolatedScript> m_scripts;
+
+		std::vector<Instance> m_instances;
+		std::vector<int> m_freeInstances;
+		std::vector<std::vector<uint32_t>> m_freeSlots;
+		uint32_t m_nextSlot = 0;
+		uint64_t m_submitted = 0;
+	};
+
+	// Worker side, entry point of the ns-host executable
+	int runIsolatedHost(const std::string& libraryPath, const std::string& memoryName);
+
+}
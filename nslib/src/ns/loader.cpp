@@ -1,37 +1,109 @@
 #include "loader.h"
+#include "accounting.h"
 
 #include <filesystem>
-#include <assert.h>
+#include <mutex>
+#include <stdio.h>
+
+#ifndef _WIN32
+	#include <dlfcn.h>
+#endif
 
 namespace ns {
 
 #ifdef _WIN32
+	typedef HMODULE ModuleHandle;
+
 	static FARPROC __stdcall tryLoadFunction(HMODULE module, const char* functionName) {
 		auto func = GetProcAddress(module, functionName);
 		if (func == NULL) {
 			printf("Failed to load function from dll\n");
 		}
 
+		return func;
+	}
+#else
+	typedef void* ModuleHandle;
+
+	static void* tryLoadFunction(void* module, const char* functionName) {
+		void* func = dlsym(module, functionName);
+		if (func == NULL) {
+			printf("Failed to load function from shared library: %s\n", dlerror());
+		}
+
 		return func;
 	}
 #endif
 
-	std::shared_ptr<ScriptCollection> ScriptCollection::create(const std::string& path) {
+	static void freeLibrary(void* handle) {
 #ifdef _WIN32
+		if (handle && !FreeLibrary((HMODULE)handle)) {
+			DWORD errorCode = GetLastError();
+			printf("Failed to free dll. Error code: %ld\n", errorCode);
+		}
+#else
+		if (handle && dlclose(handle) != 0) {
+			printf("Failed to free shared library: %s\n", dlerror());
+		}
+#endif
+	}
+
+	// Loading a library twice returns the same handle and with it the same generated allocator
+	// state, so collections sharing a handle also share its accounting ids.
+	struct SharedLibrary {
+		int references = 0;
+		int accountingId = -1;
+		std::unordered_map<std::string, int> types;
+	};
+
+	static std::mutex s_sharedLibrariesMutex;
+	static std::unordered_map<void*, SharedLibrary> s_sharedLibraries;
+
+	static ScriptAllocator makeCountingAllocator(const ScriptAllocator& allocator, int type) {
+		ScriptAllocator result = allocator;
+		result.onCreated = &recordScriptCreated;
+		result.onDestroyed = &recordScriptDestroyed;
+		result.countType = type;
+		return result;
+	}
+
+	// Approximate heap usage of the loaded metadata, including container overhead
+	static size_t estimateMetadataBytes(const std::unordered_map<std::string, ScriptInterface>& scripts) {
+		size_t bytes = scripts.bucket_count() * sizeof(void*);
+		for (const auto& [name, scriptInterface] : scripts) {
+			bytes += sizeof(std::pair<const std::string, ScriptInterface>) + 2 * sizeof(void*);
+			bytes += name.capacity() + scriptInterface.name.capacity();
+			bytes += scriptInterface.parameters.capacity() * sizeof(Parameter);
+			bytes += scriptInterface.functions.capacity() * sizeof(Function);
+			for (const Parameter& parameter : scriptInterface.parameters) {
+				bytes += parameter.name.capacity();
+			}
+		}
+		return bytes;
+	}
+
+	std::shared_ptr<ScriptCollection> ScriptCollection::create(const std::string& path) {
 		namespace fs = std::filesystem;
 
 		fs::path filePath = fs::absolute(path);
 
 		// Load DLL
+#ifdef _WIN32
 		void* handle = LoadLibraryA(filePath.generic_string().c_str());
+#else
+		void* handle = dlopen(filePath.generic_string().c_str(), RTLD_NOW | RTLD_LOCAL);
+#endif
 		if (!handle) {
 			return nullptr;
 		}
 
 		// Retrieve content info
-		GetGeneratedScriptsFn scriptInfoFunc = (GetGeneratedScriptsFn)tryLoadFunction((HMODULE)handle, "getGeneratedScripts");
-
-		assert(scriptInfoFunc);
+		GetGeneratedScriptsFn scriptInfoFunc = (GetGeneratedScriptsFn)tryLoadFunction((ModuleHandle)handle, "getGeneratedScripts");
+		if (!scriptInfoFunc) {
+			printf("Not a script library: %s\n", filePath.generic_string().c_str());
+			freeLibrary(handle);
+			return nullptr;
+		}
 
 		int count;
 		ScriptInfo* scripts;
@@ -47,39 +119,127 @@ namespace ns {
 			std::vector<Function> functions;
 
 			for (const auto& param : info.parameters) {
-				void* getFunc = tryLoadFunction((HMODULE)handle, param.nameGetFn.c_str());
-				void* setFunc = tryLoadFunction((HMODULE)handle, param.nameSetFn.c_str());
+				void* getFunc = tryLoadFunction((ModuleHandle)handle, param.nameGetFn.c_str());
+				void* setFunc = tryLoadFunction((ModuleHandle)handle, param.nameSetFn.c_str());
 
-				assert(getFunc);
-				assert(setFunc);
+				if (!getFunc || !setFunc) {
+					printf("Missing accessors for %s::%s\n", info.name.c_str(), param.name.c_str());
+					freeLibrary(handle);
+					return nullptr;
+				}
 
-				parameters.emplace_back(Parameter{ getFunc, setFunc });
+				parameters.emplace_back(Parameter{ getFunc, setFunc, param.type, param.name });
 			}
 
 			// TODO(Neathan): Implement functions
 
-			CreateScriptFn createFunc = (CreateScriptFn)tryLoadFunction((HMODULE)handle, info.nameCreateFn.c_str());
-			DestroyScriptFn destroyFunc = (DestroyScriptFn)tryLoadFunction((HMODULE)handle, info.nameDestroyFn.c_str());
+			CreateScriptFn createFunc = (CreateScriptFn)tryLoadFunction((ModuleHandle)handle, info.nameCreateFn.c_str());
+			DestroyScriptFn destroyFunc = (DestroyScriptFn)tryLoadFunction((ModuleHandle)handle, info.nameDestroyFn.c_str());
 
-			assert(createFunc);
-			assert(destroyFunc);
+			SizeScriptFn sizeFunc = (SizeScriptFn)tryLoadFunction((ModuleHandle)handle, info.nameSizeFn.c_str());
+			SetScriptAllocatorFn setAllocatorFunc = (SetScriptAllocatorFn)tryLoadFunction((ModuleHandle)handle, info.nameSetAllocatorFn.c_str());
 
-			interfaces.emplace(info.name, ScriptInterface{ info.name, parameters, functions, createFunc, destroyFunc });
+			// Libraries generated by an older nsg lack the size and allocator exports
+			if (!createFunc || !destroyFunc || !sizeFunc || !setAllocatorFunc) {
+				printf("Missing generated functions for %s, regenerate the library with nsg\n", info.name.c_str());
+				freeLibrary(handle);
+				return nullptr;
+			}
+
+			interfaces.emplace(info.name, ScriptInterface{ info.name, parameters, functions, createFunc, destroyFunc, setAllocatorFunc, sizeFunc() });
 		}
 
-		return std::make_shared<ScriptCollection>(handle, scriptInfoFunc, interfaces);
-#else
-		return nullptr;
-#endif
+		auto collection = std::make_shared<ScriptCollection>(handle, scriptInfoFunc, interfaces);
+
+		std::lock_guard<std::mutex> lock(s_sharedLibrariesMutex);
+		SharedLibrary& shared = s_sharedLibraries[handle];
+		if (shared.references++ == 0) {
+			shared.accountingId = registerLibrary(filePath.generic_string(), estimateMetadataBytes(collection->m_scripts));
+			for (auto& [name, scriptInterface] : collection->m_scripts) {
+				int type = registerScriptType(shared.accountingId, name, scriptInterface.size);
+				shared.types[name] = type;
+				scriptInterface.setAllocatorFunc(makeCountingAllocator(ScriptAllocator{}, type));
+			}
+		}
+
+		collection->m_accountingId = shared.accountingId;
+		for (auto& [name, scriptInterface] : collection->m_scripts) {
+			scriptInterface.accountingId = shared.types[name];
+		}
+
+		return collection;
+	}
+
+	Script* ScriptCollection::createScript(const std::string& name) {
+		auto it = m_scripts.find(name);
+		if (it == m_scripts.end()) {
+			printf("No script named: %s\n", name.c_str());
+			return nullptr;
+		}
+
+		Script* script = it->second.createScriptFunc();
+		if (!script) {
+			printf("Failed to allocate script: %s\n", name.c_str());
+			return nullptr;
+		}
+		m_instances.emplace(script, &it->second);
+		m_instanceKeys.emplace(script, m_nextInstanceKey++);
+		return script;
+	}
+
+	uint64_t ScriptCollection::getInstanceKey(Script* script) const {
+		auto it = m_instanceKeys.find(script);
+		return it != m_instanceKeys.end() ? it->second : 0;
+	}
+
+	void ScriptCollection::destroyScript(Script* script) {
+		auto it = m_instances.find(script);
+		if (it == m_instances.end()) {
+			printf("Script was not created by this collection\n");
+			return;
+		}
+
+		it->second->destroyScriptFunc(script);
+		m_instances.erase(it);
+		m_instanceKeys.erase(script);
+	}
+
+	bool ScriptCollection::setAllocator(const std::string& name, const ScriptAllocator& allocator) {
+		auto it = m_scripts.find(name);
+		if (it == m_scripts.end()) {
+			return false;
+		}
+
+		if (allocator.maxSize != 0 && allocator.maxSize < it->second.size) {
+			printf("Allocator blocks of %zu bytes are too small for %s (%zu bytes)\n", allocator.maxSize, name.c_str(), it->second.size);
+			return false;
+		}
+
+		// Counted by the generated functions, covers instances of every collection sharing the library
+		if (getLiveInstances(it->second.accountingId) > 0) {
+			printf("Can not change allocator of %s while instances are alive\n", name.c_str());
+			return false;
+		}
+
+		it->second.setAllocatorFunc(makeCountingAllocator(allocator, it->second.accountingId));
+		return true;
 	}
 
 	ScriptCollection::~ScriptCollection() {
-#ifdef _WIN32
-		if (m_handle && !FreeLibrary((HMODULE)m_handle)) {
-			DWORD errorCode = GetLastError();
-			printf("Failed to free dll. Error code: %ld\n", errorCode);
+		for (const auto& [script, scriptInterface] : m_instances) {
+			scriptInterface->destroyScriptFunc(script);
 		}
-#endif
+
+		{
+			std::lock_guard<std::mutex> lock(s_sharedLibrariesMutex);
+			auto it = s_sharedLibraries.find(m_handle);
+			if (it != s_sharedLibraries.end() && --it->second.references == 0) {
+				unregisterLibrary(it->second.accountingId);
+				s_sharedLibraries.erase(it);
+			}
+		}
+
+		freeLibrary(m_handle);
 	}
 
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include <stdint.h>
 
 #ifdef _WIN32
 	#include <windows.h>
@@ -19,6 +20,8 @@ namespace ns {
 
 	typedef Script* (*CreateScriptFn)();
 	typedef void (*DestroyScriptFn)(Script*);
+	typedef size_t (*SizeScriptFn)();
+	typedef void (*SetScriptAllocatorFn)(ScriptAllocator);
 
 	typedef int (*GetIntFn)(Script*);
 	typedef char (*GetCharFn)(Script*);
@@ -34,10 +37,23 @@ namespace ns {
 	typedef void (*SetDoubleFn)(Script*, double);
 	typedef void (*SetWCharFn)(Script*, wchar_t);
 
+	// Type erased property value, large enough for every ParameterType
+	union Value {
+		int asInt;
+		char asChar;
+		bool asBool;
+		float asFloat;
+		double asDouble;
+		wchar_t asWChar;
+	};
+
 	struct Parameter {
 		void* getFunc = nullptr;
 		void* setFunc = nullptr;
 
+		ParameterType type = ParameterType::ERROR_T;
+		std::string name;
+
 		int getAsInt(Script* script) const {
 			return ((GetIntFn)getFunc)(script);
 		}
@@ -76,6 +92,33 @@ namespace ns {
 		void set(Script* script, wchar_t value) const {
 			((SetWCharFn)setFunc)(script, value);
 		}
+
+
+		Value getValue(Script* script) const {
+			Value value{};
+			switch (type) {
+			case ParameterType::INT: value.asInt = getAsInt(script); break;
+			case ParameterType::CHAR: value.asChar = getAsChar(script); break;
+			case ParameterType::BOOL: value.asBool = getAsBool(script); break;
+			case ParameterType::FLOAT: value.asFloat = getAsFloat(script); break;
+			case ParameterType::DOUBLE: value.asDouble = getAsDouble(script); break;
+			case ParameterType::WCHAR_T: value.asWChar = getAsWChar(script); break;
+			default: break;
+			}
+			return value;
+		}
+
+		void setValue(Script* script, const Value& value) const {
+			switch (type) {
+			case ParameterType::INT: set(script, value.asInt); break;
+			case ParameterType::CHAR: set(script, value.asChar); break;
+			case ParameterType::BOOL: set(script, value.asBool); break;
+			case ParameterType::FLOAT: set(script, value.asFloat); break;
+			case ParameterType::DOUBLE: set(script, value.asDouble); break;
+			case ParameterType::WCHAR_T: set(script, value.asWChar); break;
+			default: break;
+			}
+		}
 	};
 
 	struct Function {
@@ -89,6 +132,17 @@ namespace ns {
 
 		CreateScriptFn createScriptFunc = nullptr;
 		DestroyScriptFn destroyScriptFunc = nullptr;
+		SetScriptAllocatorFn setAllocatorFunc = nullptr;
+
+		size_t size = 0;
+		int accountingId = -1;
+	};
+
+	class Checkpoint;
+
+	struct RestoredScript {
+		uint64_t key;
+		Script* script;
 	};
 
 	class ScriptCollection {
@@ -100,6 +154,26 @@ namespace ns {
 		const std::unordered_map<std::string, ScriptInterface>& getScripts() const { return m_scripts; }
 		const ScriptInterface& getScriptInterface(const std::string& name) const { return m_scripts.at(name); }
 
+		// Instances created through the collection are tracked and destroyed with it.
+		// Returns nullptr for unknown names and when the script allocator is out of memory.
+		Script* createScript(const std::string& name);
+		void destroyScript(Script* script);
+		const std::unordered_map<Script*, const ScriptInterface*>& getInstances() const { return m_instances; }
+		// Stable id of a tracked instance, kept across checkpoint and restore. Returns 0 for unknown scripts.
+		uint64_t getInstanceKey(Script* script) const;
+
+		// Only possible while the script has no live instances, the allocator must outlive them.
+		// Collections loaded from the same library share the allocator of each script.
+		bool setAllocator(const std::string& name, const ScriptAllocator& allocator);
+
+		// Writes the type, key and properties of every tracked instance, see checkpoint.h
+		bool checkpoint(const std::string& path) const;
+		// Recreates the instances stored in a checkpoint, either all of them or only those of one script.
+		// Restored instances get their checkpointed key back. Instances whose key is already used by a live
+		// instance of the collection are skipped, so restoring the same checkpoint twice creates nothing.
+		std::vector<RestoredScript> restore(const Checkpoint& checkpoint);
+		std::vector<RestoredScript> restore(const Checkpoint& checkpoint, const std::string& name);
+
 		static std::shared_ptr<ScriptCollection> create(const std::string& path);
 
 	private:
@@ -107,6 +181,11 @@ namespace ns {
 		GetGeneratedScriptsFn m_scriptInfoFunc = nullptr;
 
 		std::unordered_map<std::string, ScriptInterface> m_scripts;
+		std::unordered_map<Script*, const ScriptInterface*> m_instances;
+		std::unordered_map<Script*, uint64_t> m_instanceKeys;
+		uint64_t m_nextInstanceKey = 1;
+
+		int m_accountingId = -1;
 	};
 
 }
@@ -0,0 +1,164 @@
+#include "scheduler.h"
+
+#ifdef NS_COROUTINES
+
+#include <stdio.h>
+#include <utility>
+#include <algorithm>
+
+namespace ns {
+
+	Scheduler::~Scheduler() {
+		clear();
+	}
+
+	void Scheduler::spawn(Task task, const Script* owner) {
+		if (!task.valid()) {
+			return;
+		}
+
+		Task::Handle handle = task.release();
+		handle.promise().owner = owner;
+		m_nextFrame.push_back(handle);
+		++m_taskCount;
+	}
+
+	void Scheduler::cancel(const Script* owner) {
+		auto isOwned = [owner](Task::Handle handle) { return handle && handle.promise().owner == owner; };
+		size_t cancelled = 0;
+
+		auto removeOwned = [&](std::vector<Task::Handle>& handles) {
+			size_t count = handles.size();
+			for (size_t i = 0; i < count;) {
+				if (isOwned(handles[i])) {
+					handles[i].destroy();
+					handles[i] = handles[--count];
+					++cancelled;
+				}
+				else {
+					++i;
+				}
+			}
+			handles.resize(count);
+		};
+		removeOwned(m_nextFrame);
+		removeOwned(m_polling);
+
+		size_t timerCount = m_timers.size();
+		for (size_t i = 0; i < timerCount;) {
+			if (isOwned(m_timers[i].handle)) {
+				m_timers[i].handle.destroy();
+				m_timers[i] = m_timers[--timerCount];
+				++cancelled;
+			}
+			else {
+				++i;
+			}
+		}
+		if (timerCount != m_timers.size()) {
+			m_timers.resize(timerCount);
+			std::make_heap(m_timers.begin(), m_timers.end());
+		}
+
+		// Called from a task during tick(), drop owned tasks that have not been resumed yet
+		for (Task::Handle& handle : m_ready) {
+			if (isOwned(handle)) {
+				handle.destroy();
+				handle = nullptr;
+				++cancelled;
+			}
+		}
+
+		m_taskCount -= cancelled;
+	}
+
+	void Scheduler::tick(float deltaTime) {
+		m_time += deltaTime;
+
+		// Collect everything that is due before resuming, tasks parked while
+		// resuming will not run again until the next tick.
+		m_ready.clear();
+		std::swap(m_ready, m_nextFrame);
+
+		while (!m_timers.empty() && m_timers.front().wakeTime <= m_time) {
+			std::pop_heap(m_timers.begin(), m_timers.end());
+			m_ready.push_back(m_timers.back().handle);
+			m_timers.pop_back();
+		}
+
+		size_t pollCount = m_polling.size();
+		for (size_t i = 0; i < pollCount;) {
+			Task::Handle handle = m_polling[i];
+			if (handle.promise().wait.predicate()) {
+				m_ready.push_back(handle);
+				m_polling[i] = m_polling[--pollCount];
+				m_polling.pop_back();
+			}
+			else {
+				++i;
+			}
+		}
+
+		// Entries are cleared before resuming so cancel() and clear() only see tasks still waiting to run
+		for (size_t i = 0; i < m_ready.size(); ++i) {
+			Task::Handle handle = std::exchange(m_ready[i], nullptr);
+			if (handle) {
+				resume(handle);
+			}
+		}
+		m_ready.clear();
+	}
+
+	void Scheduler::clear() {
+		for (Task::Handle handle : m_nextFrame) handle.destroy();
+		for (Task::Handle handle : m_polling) handle.destroy();
+		for (const Timer& timer : m_timers) timer.handle.destroy();
+		for (Task::Handle& handle : m_ready) {
+			if (handle) handle.destroy();
+			handle = nullptr;
+		}
+
+		m_nextFrame.clear();
+		m_polling.clear();
+		m_timers.clear();
+		m_taskCount = 0;
+	}
+
+	void Scheduler::resume(Task::Handle handle) {
+		handle.promise().wait = WaitState{ WaitType::NONE, 0.0f, nullptr };
+		handle.resume();
+
+		if (handle.done()) {
+			if (handle.promise().exception) {
+				printf("Script task terminated by an unhandled exception\n");
+			}
+			handle.destroy();
+			--m_taskCount;
+			return;
+		}
+
+		park(handle);
+	}
+
+	void Scheduler::park(Task::Handle handle) {
+		WaitState& wait = handle.promise().wait;
+
+		switch (wait.type) {
+		case WaitType::SECONDS:
+			m_timers.push_back(Timer{ m_time + wait.seconds, m_timerSequence++, handle });
+			std::push_heap(m_timers.begin(), m_timers.end());
+			break;
+		case WaitType::UNTIL:
+			m_polling.push_back(handle);
+			break;
+		case WaitType::NEXT_FRAME:
+		default:
+			// NOTE: Suspending on a foreign awaitable is treated as waiting for the next frame
+			m_nextFrame.push_back(handle);
+			break;
+		}
+	}
+
+}
+
+#endif
@@ -0,0 +1,66 @@
+#pragma once
+
+#ifdef NS_COROUTINES
+
+#include "ns.h"
+#include "task.h"
+
+#include <vector>
+
+namespace ns {
+
+	class Scheduler {
+	public:
+		Scheduler() = default;
+		~Scheduler();
+
+		Scheduler(const Scheduler&) = delete;
+		Scheduler& operator=(const Scheduler&) = delete;
+
+		// Takes ownership of the task, it starts running on the next tick. Empty tasks are ignored.
+		// Tasks spawned for a script hold its this pointer, call cancel() before destroying the script.
+		void spawn(Task task, const Script* owner = nullptr);
+		void spawn(Script* script) { spawn(script->run(), script); }
+
+		// Destroys every task spawned for the script without resuming it.
+		// Must not be called from inside one of the cancelled tasks.
+		void cancel(const Script* owner);
+
+		// Resumes every task whose wait condition is met. Idle tasks waiting on
+		// frames or timers are not touched, only tasks waiting on a predicate are polled.
+		void tick(float deltaTime);
+
+		// Destroys all suspended tasks without resuming them
+		void clear();
+
+		size_t getTaskCount() const { return m_taskCount; }
+		double getTime() const { return m_time; }
+
+	private:
+		struct Timer {
+			double wakeTime;
+			unsigned long long sequence;
+			Task::Handle handle;
+
+			// Min heap ordering for the std heap algorithms
+			bool operator<(const Timer& other) const {
+				return wakeTime != other.wakeTime ? wakeTime > other.wakeTime : sequence > other.sequence;
+			}
+		};
+
+		void resume(Task::Handle handle);
+		void park(Task::Handle handle);
+
+		std::vector<Task::Handle> m_nextFrame;
+		std::vector<Task::Handle> m_ready;
+		std::vector<Task::Handle> m_polling;
+		std::vector<Timer> m_timers;
+
+		double m_time = 0.0;
+		unsigned long long m_timerSequence = 0;
+		size_t m_taskCount = 0;
+	};
+
+}
+
+#endif
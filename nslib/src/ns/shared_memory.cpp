@@ -0,0 +1,124 @@
+#include "shared_memory.h"
+
+#include <stdio.h>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <errno.h>
+	#include <string.h>
+#endif
+
+namespace ns {
+
+	std::shared_ptr<SharedMemory> SharedMemory::create(const std::string& name, size_t size) {
+#ifdef _WIN32
+		HANDLE handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)size >> 32), (DWORD)(size & 0xFFFFFFFF), name.c_str());
+		if (handle == NULL || GetLastError() == ERROR_ALREADY_EXISTS) {
+			printf("Failed to create shared memory. Error code: %ld\n", GetLastError());
+			if (handle) CloseHandle(handle);
+			return nullptr;
+		}
+
+		void* data = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+		if (!data) {
+			printf("Failed to map shared memory. Error code: %ld\n", GetLastError());
+			CloseHandle(handle);
+			return nullptr;
+		}
+
+		return std::make_shared<SharedMemory>(handle, data, size, name, true);
+#else
+		int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd < 0) {
+			printf("Failed to create shared memory: %s\n", strerror(errno));
+			return nullptr;
+		}
+
+		if (ftruncate(fd, (off_t)size) != 0) {
+			printf("Failed to resize shared memory: %s\n", strerror(errno));
+			close(fd);
+			shm_unlink(name.c_str());
+			return nullptr;
+		}
+
+		void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (data == MAP_FAILED) {
+			printf("Failed to map shared memory: %s\n", strerror(errno));
+			shm_unlink(name.c_str());
+			return nullptr;
+		}
+
+		return std::make_shared<SharedMemory>(nullptr, data, size, name, true);
+#endif
+	}
+
+	std::shared_ptr<SharedMemory> SharedMemory::open(const std::string& name) {
+#ifdef _WIN32
+		HANDLE handle = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+		if (handle == NULL) {
+			printf("Failed to open shared memory. Error code: %ld\n", GetLastError());
+			return nullptr;
+		}
+
+		void* data = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+		MEMORY_BASIC_INFORMATION info;
+		if (!data || VirtualQuery(data, &info, sizeof(info)) == 0) {
+			printf("Failed to map shared memory. Error code: %ld\n", GetLastError());
+			if (data) UnmapViewOfFile(data);
+			CloseHandle(handle);
+			return nullptr;
+		}
+
+		return std::make_shared<SharedMemory>(handle, data, info.RegionSize, name, false);
+#else
+		int fd = shm_open(name.c_str(), O_RDWR, 0600);
+		if (fd < 0) {
+			printf("Failed to open shared memory: %s\n", strerror(errno));
+			return nullptr;
+		}
+
+		struct stat status;
+		if (fstat(fd, &status) != 0) {
+			printf("Failed to query shared memory: %s\n", strerror(errno));
+			close(fd);
+			return nullptr;
+		}
+
+		size_t size = (size_t)status.st_size;
+		void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if (data == MAP_FAILED) {
+			printf("Failed to map shared memory: %s\n", strerror(errno));
+			return nullptr;
+		}
+
+		return std::make_shared<SharedMemory>(nullptr, data, size, name, false);
+#endif
+	}
+
+	void SharedMemory::unlink() {
+#ifndef _WIN32
+		if (m_owner && !m_name.empty()) {
+			shm_unlink(m_name.c_str());
+		}
+#endif
+		m_name.clear();
+	}
+
+	SharedMemory::~SharedMemory() {
+#ifdef _WIN32
+		if (m_data) UnmapViewOfFile(m_data);
+		if (m_handle) CloseHandle((HANDLE)m_handle);
+#else
+		if (m_data) munmap(m_data, m_size);
+		unlink();
+#endif
+	}
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <memory>
+
+namespace ns {
+
+	class SharedMemory {
+	public:
+		SharedMemory(void* handle, void* data, size_t size, const std::string& name, bool owner)
+			: m_handle(handle), m_data(data), m_size(size), m_name(name), m_owner(owner) {}
+		~SharedMemory();
+
+		SharedMemory(const SharedMemory&) = delete;
+		SharedMemory& operator=(const SharedMemory&) = delete;
+
+		void* getData() const { return m_data; }
+		size_t getSize() const { return m_size; }
+		const std::string& getName() const { return m_name; }
+
+		// Removes the name so no further process can open the region, existing mappings stay valid
+		void unlink();
+
+		// Creates a new zero initialized region, fails if the name is already in use
+		static std::shared_ptr<SharedMemory> create(const std::string& name, size_t size);
+		static std::shared_ptr<SharedMemory> open(const std::string& name);
+
+	private:
+		void* m_handle = nullptr;
+		void* m_data = nullptr;
+		size_t m_size = 0;
+		std::string m_name;
+		bool m_owner = false;
+	};
+
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#ifdef NS_COROUTINES
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <utility>
+#include <stddef.h>
+
+namespace ns {
+
+	// NOTE: Header only so that script libraries can use it without linking nslib.
+	//  Frames are allocated and freed by the library that compiled the coroutine.
+	class FramePool {
+	public:
+		static void* allocate(size_t size) {
+			size_t index = classIndex(size);
+			if (index >= CLASS_COUNT) {
+				return ::operator new(size);
+			}
+
+			FreeBlock*& head = freeLists().heads[index];
+			if (head) {
+				FreeBlock* block = head;
+				head = block->next;
+				return block;
+			}
+			return ::operator new((index + 1) * GRANULARITY);
+		}
+
+		static void deallocate(void* ptr, size_t size) {
+			size_t index = classIndex(size);
+			if (index >= CLASS_COUNT) {
+				::operator delete(ptr);
+				return;
+			}
+
+			FreeBlock* block = (FreeBlock*)ptr;
+			FreeBlock*& head = freeLists().heads[index];
+			block->next = head;
+			head = block;
+		}
+
+	private:
+		static constexpr size_t GRANULARITY = 64;
+		static constexpr size_t CLASS_COUNT = 16;
+
+		struct FreeBlock {
+			FreeBlock* next;
+		};
+
+		struct FreeLists {
+			FreeBlock* heads[CLASS_COUNT] = {};
+
+			~FreeLists() {
+				for (FreeBlock*& head : heads) {
+					while (head) {
+						FreeBlock* next = head->next;
+						::operator delete(head);
+						head = next;
+					}
+				}
+			}
+		};
+
+		static size_t classIndex(size_t size) { return (size + GRANULARITY - 1) / GRANULARITY - 1; }
+
+		static FreeLists& freeLists() {
+			thread_local FreeLists lists;
+			return lists;
+		}
+	};
+
+	enum class WaitType : int {
+		NONE		= 0,
+		NEXT_FRAME	= 1,
+		SECONDS		= 2,
+		UNTIL		= 3
+	};
+
+	// Written by the awaitables when a task suspends, read by the scheduler to decide where to park it
+	struct WaitState {
+		WaitType type = WaitType::NONE;
+		float seconds = 0.0f;
+		std::function<bool()> predicate;
+	};
+
+	class Task {
+	public:
+		struct promise_type {
+			WaitState wait;
+			std::exception_ptr exception;
+			// Script the task was spawned for, used by Scheduler::cancel
+			const void* owner = nullptr;
+
+			Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+			std::suspend_always initial_suspend() noexcept { return {}; }
+			std::suspend_always final_suspend() noexcept { return {}; }
+			void return_void() {}
+			void unhandled_exception() { exception = std::current_exception(); }
+
+			static void* operator new(size_t size) { return FramePool::allocate(size); }
+			static void operator delete(void* ptr, size_t size) { FramePool::deallocate(ptr, size); }
+		};
+
+		using Handle = std::coroutine_handle<promise_type>;
+
+		Task() = default;
+		explicit Task(Handle handle) : m_handle(handle) {}
+		Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+		Task& operator=(Task&& other) noexcept {
+			if (this != &other) {
+				if (m_handle) m_handle.destroy();
+				m_handle = std::exchange(other.m_handle, nullptr);
+			}
+			return *this;
+		}
+		Task(const Task&) = delete;
+		Task& operator=(const Task&) = delete;
+		~Task() {
+			if (m_handle) m_handle.destroy();
+		}
+
+		bool valid() const { return (bool)m_handle; }
+
+		// Hands the coroutine frame over to the caller, the task is empty afterwards
+		Handle release() { return std::exchange(m_handle, nullptr); }
+
+	private:
+		Handle m_handle = nullptr;
+	};
+
+	struct NextFrameAwaiter {
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(Task::Handle handle) const noexcept {
+			handle.promise().wait = WaitState{ WaitType::NEXT_FRAME, 0.0f, nullptr };
+		}
+		void await_resume() const noexcept {}
+	};
+
+	struct SecondsAwaiter {
+		float duration;
+
+		bool await_ready() const noexcept { return duration <= 0.0f; }
+		void await_suspend(Task::Handle handle) const noexcept {
+			handle.promise().wait = WaitState{ WaitType::SECONDS, duration, nullptr };
+		}
+		void await_resume() const noexcept {}
+	};
+
+	struct UntilAwaiter {
+		std::function<bool()> predicate;
+
+		bool await_ready() const { return predicate(); }
+		void await_suspend(Task::Handle handle) {
+			handle.promise().wait = WaitState{ WaitType::UNTIL, 0.0f, std::move(predicate) };
+		}
+		void await_resume() const noexcept {}
+	};
+
+	inline NextFrameAwaiter nextFrame() { return {}; }
+	inline SecondsAwaiter seconds(float duration) { return { duration }; }
+	inline UntilAwaiter until(std::function<bool()> predicate) { return { std::move(predicate) }; }
+
+}
+
+#endif
@@ -0,0 +1,215 @@
+#include "watcher.h"
+
+#include <set>
+#include <map>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+	#include <sys/inotify.h>
+	#include <poll.h>
+	#include <unistd.h>
+	#include <errno.h>
+	#include <string.h>
+#endif
+
+namespace ns {
+
+	namespace fs = std::filesystem;
+
+#ifdef __linux__
+	static constexpr int MIN_RETRY_MS = 100;
+	static constexpr int MAX_RETRY_MS = 30000;
+
+	static constexpr uint32_t DIRECTORY_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE;
+
+	static bool isInside(const fs::path& path, const fs::path& root) {
+		auto relative = path.lexically_relative(root);
+		return !relative.empty() && *relative.begin() != "..";
+	}
+
+	// inotify is not recursive, every directory of the tree needs its own watch
+	static void addWatches(int fd, const fs::path& directory, const fs::path& outputRoot, std::map<int, fs::path>& directories) {
+		if (directory == outputRoot || isInside(directory, outputRoot)) {
+			return;
+		}
+
+		int wd = inotify_add_watch(fd, directory.generic_string().c_str(), DIRECTORY_EVENTS);
+		if (wd < 0) {
+			printf("Failed to watch directory %s: %s\n", directory.generic_string().c_str(), strerror(errno));
+			return;
+		}
+		directories[wd] = directory;
+
+		std::error_code error;
+		for (const auto& entry : fs::directory_iterator(directory, error)) {
+			if (entry.is_directory()) {
+				addWatches(fd, entry.path(), outputRoot, directories);
+			}
+		}
+	}
+#endif
+
+	static void runBuildCommand(const std::string& buildCommand) {
+		if (buildCommand.empty()) {
+			return;
+		}
+
+		int result = system(buildCommand.c_str());
+		if (result != 0) {
+			printf("Build command failed with code %d\n", result);
+		}
+	}
+
+	int watchProject(const char* path, const char* outputPath, const WatchOptions& options) {
+#ifdef __linux__
+		using Clock = std::chrono::steady_clock;
+
+		// A missing root never gets a watch, so it could never recover
+		std::error_code rootError;
+		if (!fs::is_directory(path, rootError)) {
+			printf("Project directory does not exist: %s\n", path);
+			return 1;
+		}
+
+		ProjectGenerator generator(path, outputPath);
+		fs::path projectRoot = generator.getProjectRoot();
+		fs::path outputRoot = fs::absolute(outputPath);
+
+		int fd = inotify_init1(IN_CLOEXEC);
+		if (fd < 0) {
+			printf("Failed to initialize inotify: %s\n", strerror(errno));
+			return 1;
+		}
+
+		std::map<int, fs::path> directories;
+		addWatches(fd, projectRoot, outputRoot, directories);
+
+		std::set<std::string> pending;
+		bool rescan = false;
+		Clock::time_point firstEvent = Clock::now();
+
+		// Failed generations are retried with a full rescan, backing off while the error persists
+		int retryDelayMs = 0;
+		auto scheduleRetry = [&](const char* message, const fs::filesystem_error& error) {
+			retryDelayMs = retryDelayMs == 0 ? std::max(options.debounceMs, MIN_RETRY_MS) : std::min(retryDelayMs * 2, MAX_RETRY_MS);
+			printf("%s, retrying in %d ms: %s\n", message, retryDelayMs, error.what());
+			fflush(stdout);
+			pending.clear();
+			rescan = true;
+		};
+
+		try {
+			generator.generate();
+			runBuildCommand(options.buildCommand);
+		}
+		catch (const fs::filesystem_error& error) {
+			scheduleRetry("Failed to generate project", error);
+		}
+		printf("Watching %s\n", projectRoot.generic_string().c_str());
+		fflush(stdout);
+
+		alignas(inotify_event) char buffer[64 * 1024];
+		pollfd descriptor = { fd, POLLIN, 0 };
+
+		while (true) {
+			int timeout = pending.empty() && !rescan ? -1 : (retryDelayMs > 0 ? retryDelayMs : options.debounceMs);
+			int ready = poll(&descriptor, 1, timeout);
+			if (ready < 0) {
+				if (errno == EINTR) continue;
+				printf("Failed to wait for file events: %s\n", strerror(errno));
+				close(fd);
+				return 1;
+			}
+
+			if (ready == 0) {
+				// Quiet for the debounce period, process the burst
+				size_t changed = 0;
+				try {
+					if (rescan) {
+						generator.generate();
+						changed = generator.getFileCount();
+					}
+					else {
+						for (const std::string& filePath : pending) {
+							changed += generator.updateFile(filePath) ? 1 : 0;
+						}
+						if (changed > 0) {
+							generator.writeScripts();
+						}
+					}
+				}
+				catch (const fs::filesystem_error& error) {
+					// Files can vanish or be locked mid scan, regenerate everything once things settle
+					scheduleRetry("Failed to regenerate project", error);
+					continue;
+				}
+				retryDelayMs = 0;
+
+				if (changed > 0) {
+					double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - firstEvent).count();
+					if (rescan) {
+						printf("Regenerated project, %.1f ms after first change\n", elapsed);
+					}
+					else {
+						printf("Regenerated %zu file(s), %.1f ms after first change\n", changed, elapsed);
+					}
+					fflush(stdout);
+					runBuildCommand(options.buildCommand);
+				}
+
+				pending.clear();
+				rescan = false;
+				continue;
+			}
+
+			ssize_t length = read(fd, buffer, sizeof(buffer));
+			if (length <= 0) {
+				continue;
+			}
+			if (pending.empty() && !rescan) {
+				firstEvent = Clock::now();
+			}
+
+			for (char* it = buffer; it < buffer + length;) {
+				const inotify_event* event = (const inotify_event*)it;
+				it += sizeof(inotify_event) + event->len;
+
+				if (event->mask & IN_Q_OVERFLOW) {
+					rescan = true;
+					continue;
+				}
+				if (event->mask & IN_IGNORED) {
+					directories.erase(event->wd);
+					continue;
+				}
+
+				auto directory = directories.find(event->wd);
+				if (directory == directories.end() || event->len == 0) {
+					continue;
+				}
+				fs::path entryPath = directory->second / event->name;
+
+				if (event->mask & IN_ISDIR) {
+					// Directories appearing or disappearing change many files at once, regenerate everything
+					if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+						addWatches(fd, entryPath, outputRoot, directories);
+					}
+					rescan = true;
+				}
+				else if (!(event->mask & IN_CREATE) && ProjectGenerator::isProjectFile(entryPath.generic_string())) {
+					// NOTE: Creation is followed by a close after writing, wait for that one
+					pending.insert(entryPath.generic_string());
+				}
+			}
+		}
+#else
+		printf("Watch mode is only supported on Linux\n");
+		return 1;
+#endif
+	}
+
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "generator.h"
+
+#include <string>
+
+namespace ns {
+
+	struct WatchOptions {
+		// Time without new events before a burst of saves is processed
+		int debounceMs = 20;
+		// Run after every regeneration when not empty
+		std::string buildCommand;
+	};
+
+	// Generates the project once and then regenerates touched files until the process is stopped.
+	// Returns non zero if watching is not possible.
+	int watchProject(const char* path, const char* outputPath, const WatchOptions& options);
+
+}
@@ -0,0 +1,182 @@
+#include <ns/accounting.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { \
+		printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+		++s_failures; \
+	}
+
+// Spins until every participant has arrived, threads keep their pending counts while waiting
+class Barrier {
+public:
+	explicit Barrier(int count) : m_count(count) {}
+
+	void wait() {
+		int generation = m_generation.load();
+		if (m_waiting.fetch_add(1) + 1 == m_count) {
+			m_waiting.store(0);
+			m_generation.fetch_add(1);
+			return;
+		}
+		while (m_generation.load() == generation) {
+			std::this_thread::yield();
+		}
+	}
+
+private:
+	int m_count;
+	std::atomic<int> m_waiting = 0;
+	std::atomic<int> m_generation = 0;
+};
+
+static ns::ScriptMemoryStats findStats(const std::string& library, const std::string& name) {
+	ns::MemorySnapshot snapshot = ns::takeMemorySnapshot();
+	for (const ns::LibraryMemoryStats& stats : snapshot.libraries) {
+		if (stats.path != library) {
+			continue;
+		}
+		for (const ns::ScriptMemoryStats& script : stats.scripts) {
+			if (script.name == name) {
+				return script;
+			}
+		}
+	}
+	printf("No stats for %s in %s\n", name.c_str(), library.c_str());
+	++s_failures;
+	return {};
+}
+
+static void record(int type, int created, int destroyed) {
+	for (int i = 0; i < created; ++i) ns::recordScriptCreated(type);
+	for (int i = 0; i < destroyed; ++i) ns::recordScriptDestroyed(type);
+}
+
+void testConcurrentCounts() {
+	constexpr int THREAD_COUNT = 8;
+	int library = ns::registerLibrary("concurrent", 0);
+	int type = ns::registerScriptType(library, "Worker", 16);
+
+	// Each thread peaks at 100 live instances, then drops to 30 and climbs back to 80.
+	// No point in time has more than 100 live per thread, whatever the interleaving.
+	Barrier barrier(THREAD_COUNT + 1);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < THREAD_COUNT; ++t) {
+		threads.emplace_back([&] {
+			record(type, 100, 70);
+			barrier.wait();
+			barrier.wait();
+			record(type, 50, 0);
+			barrier.wait();
+			barrier.wait();
+		});
+	}
+
+	barrier.wait();
+	ns::ScriptMemoryStats stats = findStats("concurrent", "Worker");
+	CHECK(stats.liveInstances == 30 * THREAD_COUNT);
+	CHECK(stats.totalCreated == 100 * THREAD_COUNT);
+	CHECK(stats.peakInstances >= stats.liveInstances);
+	CHECK(stats.peakInstances <= 100 * THREAD_COUNT);
+	barrier.wait();
+
+	barrier.wait();
+	stats = findStats("concurrent", "Worker");
+	CHECK(stats.liveInstances == 80 * THREAD_COUNT);
+	CHECK(stats.totalCreated == 150 * THREAD_COUNT);
+	CHECK(stats.peakInstances >= stats.liveInstances);
+	CHECK(stats.peakInstances <= 100 * THREAD_COUNT);
+	CHECK(stats.liveBytes == (size_t)stats.liveInstances * 16);
+	barrier.wait();
+
+	for (std::thread& thread : threads) thread.join();
+
+	// Threads have exited, their counts stay
+	stats = findStats("concurrent", "Worker");
+	CHECK(stats.liveInstances == 80 * THREAD_COUNT);
+	ns::unregisterLibrary(library);
+}
+
+void testPendingDestroysDoNotInflatePeak() {
+	int library = ns::registerLibrary("pending", 0);
+	int type = ns::registerScriptType(library, "Pending", 8);
+
+	// The first thread keeps running with its destructions unpublished while the second creates.
+	// True peak is max(10, 1 + 12) = 13.
+	Barrier barrier(2);
+	std::thread first([&] {
+		record(type, 10, 9);
+		barrier.wait();
+		barrier.wait();
+	});
+	barrier.wait();
+	std::thread second([&] { record(type, 12, 0); });
+	second.join();
+
+	ns::ScriptMemoryStats stats = findStats("pending", "Pending");
+	CHECK(stats.liveInstances == 13);
+	CHECK(stats.peakInstances == 13);
+
+	barrier.wait();
+	first.join();
+	ns::unregisterLibrary(library);
+}
+
+void testReusedTypeStartsFromZero() {
+	int library = ns::registerLibrary("reused-old", 0);
+	int type = ns::registerScriptType(library, "Old", 8);
+	record(type, 40, 5);
+	CHECK(findStats("reused-old", "Old").liveInstances == 35);
+	ns::unregisterLibrary(library);
+
+	// The id is handed out again, counts this thread kept for the old type must not leak into the new one
+	int reusedLibrary = ns::registerLibrary("reused-new", 0);
+	int reused = ns::registerScriptType(reusedLibrary, "New", 8);
+	CHECK(reused == type);
+
+	ns::ScriptMemoryStats stats = findStats("reused-new", "New");
+	CHECK(stats.liveInstances == 0);
+	CHECK(stats.peakInstances == 0);
+	CHECK(stats.totalCreated == 0);
+
+	record(reused, 3, 1);
+	std::thread([&] { record(reused, 2, 0); }).join();
+	stats = findStats("reused-new", "New");
+	CHECK(stats.liveInstances == 4);
+	CHECK(stats.totalCreated == 5);
+	CHECK(stats.peakInstances >= 4 && stats.peakInstances <= 5);
+	CHECK(ns::getLiveInstances(reused) == 4);
+	ns::unregisterLibrary(reusedLibrary);
+}
+
+void testScriptPool() {
+	ns::ScriptPool pool(24, 4);
+	ns::ScriptAllocator allocator = pool.getAllocator();
+	CHECK(allocator.maxSize >= 24);
+
+	void* first = allocator.allocate(allocator.userData, 24);
+	CHECK(first != nullptr);
+	CHECK(allocator.allocate(allocator.userData, allocator.maxSize + 1) == nullptr);
+
+	allocator.free(allocator.userData, first);
+	CHECK(allocator.allocate(allocator.userData, 16) == first);
+	CHECK(pool.getReservedBytes() == 4 * allocator.maxSize);
+}
+
+int main() {
+	testConcurrentCounts();
+	testPendingDestroysDoNotInflatePeak();
+	testReusedTypeStartsFromZero();
+	testScriptPool();
+
+	if (s_failures == 0) {
+		printf("All accounting checks passed\n");
+	}
+	return s_failures == 0 ? 0 : 1;
+}
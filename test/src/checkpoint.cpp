@@ -0,0 +1,294 @@
+#include <ns/checkpoint.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace fs = std::filesystem;
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { \
+		printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+		++s_failures; \
+	}
+
+// Stands in for a generated script, the collections below are built from hand written interfaces
+class Unit final : public Script {
+public:
+	int health = 100;
+	float speed = 1.0f;
+	double armor = 0.0;
+	int level = 1;
+};
+
+static Script* createUnit() { return new Unit(); }
+static void destroyUnit(Script* script) { delete (Unit*)script; }
+static size_t sizeofUnit() { return sizeof(Unit); }
+static void setAllocatorUnit(ns::ScriptAllocator) {}
+
+static int getHealth(Script* script) { return ((Unit*)script)->health; }
+static void setHealth(Script* script, int value) { ((Unit*)script)->health = value; }
+static float getSpeed(Script* script) { return ((Unit*)script)->speed; }
+static void setSpeed(Script* script, float value) { ((Unit*)script)->speed = value; }
+static int getSpeedAsInt(Script* script) { return (int)((Unit*)script)->speed; }
+static void setSpeedAsInt(Script* script, int value) { ((Unit*)script)->speed = (float)value; }
+static double getArmor(Script* script) { return ((Unit*)script)->armor; }
+static void setArmor(Script* script, double value) { ((Unit*)script)->armor = value; }
+static int getLevel(Script* script) { return ((Unit*)script)->level; }
+static void setLevel(Script* script, int value) { ((Unit*)script)->level = value; }
+
+static ns::ScriptInterface makeUnitInterface(const std::string& name, const std::vector<ns::Parameter>& parameters) {
+	ns::ScriptInterface scriptInterface;
+	scriptInterface.name = name;
+	scriptInterface.parameters = parameters;
+	scriptInterface.createScriptFunc = &createUnit;
+	scriptInterface.destroyScriptFunc = &destroyUnit;
+	scriptInterface.setAllocatorFunc = &setAllocatorUnit;
+	scriptInterface.size = sizeofUnit();
+	return scriptInterface;
+}
+
+static std::shared_ptr<ns::ScriptCollection> makeCollection(const std::vector<ns::Parameter>& parameters, const std::string& name = "Unit") {
+	std::unordered_map<std::string, ns::ScriptInterface> scripts;
+	scripts.emplace(name, makeUnitInterface(name, parameters));
+	return std::make_shared<ns::ScriptCollection>(nullptr, nullptr, scripts);
+}
+
+static std::vector<ns::Parameter> currentSchema() {
+	return {
+		ns::Parameter{ (void*)&getHealth, (void*)&setHealth, ns::ParameterType::INT, "health" },
+		ns::Parameter{ (void*)&getSpeed, (void*)&setSpeed, ns::ParameterType::FLOAT, "speed" },
+		ns::Parameter{ (void*)&getArmor, (void*)&setArmor, ns::ParameterType::DOUBLE, "armor" },
+	};
+}
+
+static std::string tempPath(const char* name) {
+	return (fs::temp_directory_path() / name).generic_string();
+}
+
+static std::string readFile(const std::string& path) {
+	std::ifstream in(path, std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& path, const std::string& data) {
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write(data.data(), data.size());
+}
+
+// Writes a checkpoint with two instances of Unit in the current schema, returns its bytes
+static std::string writeReference(const std::string& path) {
+	auto collection = makeCollection(currentSchema());
+	Unit* first = (Unit*)collection->createScript("Unit");
+	first->health = 42;
+	first->speed = 2.5f;
+	first->armor = 7.25;
+	Unit* second = (Unit*)collection->createScript("Unit");
+	second->health = -3;
+	second->speed = 0.5f;
+	second->armor = 1.0;
+	collection->checkpoint(path);
+	return readFile(path);
+}
+
+void testRoundTrip() {
+	std::string path = tempPath("ns-checkpoint-round-trip.bin");
+
+	auto source = makeCollection(currentSchema());
+	Unit* first = (Unit*)source->createScript("Unit");
+	Unit* removed = (Unit*)source->createScript("Unit");
+	Unit* third = (Unit*)source->createScript("Unit");
+	first->health = 42;
+	first->speed = 2.5f;
+	first->armor = 7.25;
+	third->health = 9;
+	uint64_t firstKey = source->getInstanceKey(first);
+	uint64_t thirdKey = source->getInstanceKey(third);
+	source->destroyScript(removed);
+
+	CHECK(source->checkpoint(path));
+	CHECK(!fs::exists(path + ".tmp"));
+
+	auto checkpoint = ns::Checkpoint::open(path);
+	CHECK(checkpoint != nullptr);
+	if (!checkpoint) return;
+
+	auto target = makeCollection(currentSchema());
+	std::vector<ns::RestoredScript> restored = target->restore(*checkpoint);
+	CHECK(restored.size() == 2);
+	if (restored.size() != 2) return;
+
+	// Instances come back sorted by key with their values and keys intact
+	CHECK(restored[0].key == firstKey);
+	CHECK(restored[1].key == thirdKey);
+	CHECK(target->getInstanceKey(restored[0].script) == firstKey);
+	Unit* copy = (Unit*)restored[0].script;
+	CHECK(copy->health == 42 && copy->speed == 2.5f && copy->armor == 7.25);
+	CHECK(((Unit*)restored[1].script)->health == 9);
+
+	// New instances never reuse a restored key
+	Script* fresh = target->createScript("Unit");
+	CHECK(target->getInstanceKey(fresh) > thirdKey);
+
+	// Restoring again would duplicate keys, those instances are skipped
+	CHECK(target->restore(*checkpoint).empty());
+	CHECK(target->getInstances().size() == 3);
+
+	checkpoint.reset();
+	fs::remove(path);
+}
+
+void testRestoreIntoUsedCollection() {
+	std::string path = tempPath("ns-checkpoint-used.bin");
+	writeReference(path);
+	auto checkpoint = ns::Checkpoint::open(path);
+	CHECK(checkpoint != nullptr);
+	if (!checkpoint) return;
+
+	// Key 1 is taken by a live instance, only the instance with key 2 is restored
+	auto target = makeCollection(currentSchema());
+	Script* existing = target->createScript("Unit");
+	CHECK(target->getInstanceKey(existing) == 1);
+
+	std::vector<ns::RestoredScript> restored = target->restore(*checkpoint);
+	CHECK(restored.size() == 1);
+	CHECK(!restored.empty() && restored[0].key == 2);
+	CHECK(target->getInstanceKey(existing) == 1);
+
+	checkpoint.reset();
+	fs::remove(path);
+}
+
+void testMigration() {
+	std::string path = tempPath("ns-checkpoint-migration.bin");
+	writeReference(path);
+	auto checkpoint = ns::Checkpoint::open(path);
+	CHECK(checkpoint != nullptr);
+	if (!checkpoint) return;
+
+	// health was renamed to hp, speed became an int, armor was removed and level is new
+	auto target = makeCollection({
+		ns::Parameter{ (void*)&getHealth, (void*)&setHealth, ns::ParameterType::INT, "hp" },
+		ns::Parameter{ (void*)&getSpeedAsInt, (void*)&setSpeedAsInt, ns::ParameterType::INT, "speed" },
+		ns::Parameter{ (void*)&getLevel, (void*)&setLevel, ns::ParameterType::INT, "level" },
+	});
+	std::vector<ns::RestoredScript> restored = target->restore(*checkpoint);
+	CHECK(restored.size() == 2);
+	if (restored.size() != 2) return;
+
+	Unit* first = (Unit*)restored[0].script;
+	CHECK(first->health == 100);	// Renamed, keeps its default
+	CHECK(first->speed == 2.0f);	// 2.5 converted to int
+	CHECK(first->armor == 0.0);		// Removed, never written
+	CHECK(first->level == 1);		// New, keeps its default
+	CHECK(((Unit*)restored[1].script)->speed == 0.0f);
+
+	checkpoint.reset();
+	fs::remove(path);
+}
+
+void testLongNames() {
+	std::string path = tempPath("ns-checkpoint-long.bin");
+	fs::remove(path);
+
+	auto collection = makeCollection(currentSchema(), std::string(ns::CHECKPOINT_MAX_NAME, 'U'));
+	collection->createScript(std::string(ns::CHECKPOINT_MAX_NAME, 'U'));
+	CHECK(!collection->checkpoint(path));
+	CHECK(!fs::exists(path));
+	CHECK(!fs::exists(path + ".tmp"));
+}
+
+template<typename T>
+static void patch(std::string& data, size_t offset, T value) {
+	memcpy(&data[offset], &value, sizeof(T));
+}
+
+static bool opens(const std::string& path, const std::string& data) {
+	writeFile(path, data);
+	return ns::Checkpoint::open(path) != nullptr;
+}
+
+void testCorruptFiles() {
+	std::string path = tempPath("ns-checkpoint-corrupt.bin");
+	const std::string reference = writeReference(path);
+	CHECK(opens(path, reference));
+
+	const size_t typeOffset = sizeof(ns::CheckpointHeader);
+	const ns::CheckpointType type = *(const ns::CheckpointType*)&reference[typeOffset];
+	std::string data;
+
+	CHECK(!opens(path, ""));
+	CHECK(!opens(path, reference.substr(0, sizeof(ns::CheckpointHeader) - 1)));
+
+	// Truncated, with and without a matching size in the header
+	data = reference.substr(0, reference.size() - 8);
+	CHECK(!opens(path, data));
+	patch<uint64_t>(data, offsetof(ns::CheckpointHeader, size), data.size());
+	CHECK(!opens(path, data));
+
+	data = reference;
+	patch<uint32_t>(data, offsetof(ns::CheckpointHeader, magic), 0);
+	CHECK(!opens(path, data));
+
+	data = reference;
+	patch<uint32_t>(data, offsetof(ns::CheckpointHeader, version), ns::CHECKPOINT_VERSION + 1);
+	CHECK(!opens(path, data));
+
+	data = reference;
+	patch<uint32_t>(data, offsetof(ns::CheckpointHeader, typeCount), 0xFFFFFFFF);
+	CHECK(!opens(path, data));
+
+	// Offsets close to 2^64 must not wrap around when the sizes are added
+	data = reference;
+	patch<uint64_t>(data, typeOffset + offsetof(ns::CheckpointType, fieldOffset), ~0ull - 7);
+	CHECK(!opens(path, data));
+
+	data = reference;
+	patch<uint64_t>(data, typeOffset + offsetof(ns::CheckpointType, valueOffset), ~0ull - 7);
+	CHECK(!opens(path, data));
+
+	data = reference;
+	patch<uint32_t>(data, typeOffset + offsetof(ns::CheckpointType, instanceCount), 0x7FFFFFFF);
+	CHECK(!opens(path, data));
+
+	data = reference;
+	patch<uint64_t>(data, typeOffset + offsetof(ns::CheckpointType, valueOffset), type.valueOffset + 4);
+	CHECK(!opens(path, data));
+
+	data = reference;
+	memset(&data[typeOffset + offsetof(ns::CheckpointType, name)], 'U', ns::CHECKPOINT_MAX_NAME);
+	CHECK(!opens(path, data));
+
+	data = reference;
+	memset(&data[type.fieldOffset], 'f', ns::CHECKPOINT_MAX_NAME);
+	CHECK(!opens(path, data));
+
+	// Key 0 means unknown, keys must be unique and sorted
+	data = reference;
+	patch<uint64_t>(data, type.keyOffset, 0);
+	CHECK(!opens(path, data));
+
+	data = reference;
+	patch<uint64_t>(data, type.keyOffset + sizeof(uint64_t), 1);
+	CHECK(!opens(path, data));
+
+	fs::remove(path);
+}
+
+int main() {
+	testRoundTrip();
+	testRestoreIntoUsedCollection();
+	testMigration();
+	testLongNames();
+	testCorruptFiles();
+
+	if (s_failures == 0) {
+		printf("All checkpoint checks passed\n");
+	}
+	return s_failures == 0 ? 0 : 1;
+}
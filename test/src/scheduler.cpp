@@ -0,0 +1,142 @@
+#include <ns/scheduler.h>
+
+#include <stdio.h>
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	if (!(condition)) { \
+		printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+		++s_failures; \
+	}
+
+class Stages : public Script {
+public:
+	int stage = 0;
+	bool ready = false;
+
+	ns::Task run() override {
+		co_await ns::nextFrame();
+		stage = 1;
+		co_await ns::seconds(1.0f);
+		stage = 2;
+		co_await ns::until([this] { return ready; });
+		stage = 3;
+	}
+};
+
+// Counts destroyed frames through a local living in the coroutine
+struct Guard {
+	int* destroyed;
+	~Guard() { ++*destroyed; }
+};
+
+class Parked final : public Script {
+public:
+	int* destroyed = nullptr;
+	int resumed = 0;
+
+	ns::Task run() override {
+		Guard guard{ destroyed };
+		while (true) {
+			co_await ns::seconds(0.5f);
+			++resumed;
+		}
+	}
+};
+
+void testStageOrder() {
+	ns::Scheduler scheduler;
+	Stages script;
+	scheduler.spawn(&script);
+
+	scheduler.tick(0.1f);
+	CHECK(script.stage == 0);
+	scheduler.tick(0.1f);
+	CHECK(script.stage == 1);
+
+	for (int i = 0; i < 8; ++i) scheduler.tick(0.1f);
+	CHECK(script.stage == 1);
+	for (int i = 0; i < 4; ++i) scheduler.tick(0.1f);
+	CHECK(script.stage == 2);
+
+	scheduler.tick(0.1f);
+	CHECK(script.stage == 2);
+	script.ready = true;
+	scheduler.tick(0.1f);
+	CHECK(script.stage == 3);
+	CHECK(scheduler.getTaskCount() == 0);
+}
+
+void testCancel() {
+	ns::Scheduler scheduler;
+	int destroyed = 0;
+
+	Parked* removed = new Parked();
+	removed->destroyed = &destroyed;
+	Parked kept;
+	kept.destroyed = &destroyed;
+
+	scheduler.spawn(removed);
+	scheduler.spawn(&kept);
+	scheduler.tick(0.0f);
+	scheduler.tick(0.6f);
+	CHECK(removed->resumed == 1);
+	CHECK(kept.resumed == 1);
+
+	// Destroying a script mid flight, its frame must never be resumed afterwards
+	scheduler.cancel(removed);
+	delete removed;
+	CHECK(destroyed == 1);
+	CHECK(scheduler.getTaskCount() == 1);
+
+	scheduler.tick(0.6f);
+	CHECK(kept.resumed == 2);
+}
+
+void testClear() {
+	ns::Scheduler scheduler;
+	int destroyed = 0;
+
+	Parked timer;
+	timer.destroyed = &destroyed;
+	Stages polling;
+
+	scheduler.spawn(&timer);
+	scheduler.spawn(&polling);
+	for (int i = 0; i < 12; ++i) scheduler.tick(0.1f);
+	CHECK(polling.stage == 2);
+	int resumed = timer.resumed;
+
+	scheduler.clear();
+	CHECK(destroyed == 1);
+	CHECK(scheduler.getTaskCount() == 0);
+
+	polling.ready = true;
+	scheduler.tick(1.0f);
+	CHECK(polling.stage == 2);
+	CHECK(timer.resumed == resumed);
+}
+
+void testFramePoolReuse() {
+	void* first = ns::FramePool::allocate(100);
+	ns::FramePool::deallocate(first, 100);
+	void* second = ns::FramePool::allocate(120);
+	CHECK(first == second);
+	ns::FramePool::deallocate(second, 120);
+
+	void* large = ns::FramePool::allocate(64 * 1024);
+	ns::FramePool::deallocate(large, 64 * 1024);
+}
+
+int main() {
+	testStageOrder();
+	testCancel();
+	testClear();
+	testFramePoolReuse();
+
+	if (s_failures == 0) {
+		printf("All scheduler checks passed\n");
+	}
+	return s_failures == 0 ? 0 : 1;
+}